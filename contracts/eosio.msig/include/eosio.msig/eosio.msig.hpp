@@ -1,6 +1,7 @@
 #pragma once
 
 #include <eosio/binary_extension.hpp>
+#include <eosio/crypto.hpp>
 #include <eosio/eosio.hpp>
 #include <eosio/ignore.hpp>
 #include <eosio/transaction.hpp>
@@ -27,7 +28,9 @@ namespace eosio {
           * authorized by the provided keys and permissions, and if the proposal name doesn’t
           * already exist; if all validations pass the `proposal_name` and `trx` trasanction are
           * saved in the proposals table and the `requested` permission levels to the
-          * approvals table (for the `proposer` context).
+          * approvals table (for the `proposer` context). Proposals requesting more than
+          * `approval_rows_threshold` permission levels store one row per permission level instead,
+          * so that approving and unapproving them does not rewrite the whole list.
           * Storage changes are billed to `proposer`.
           *
           * @param proposer - The account proposing a transaction
@@ -125,6 +128,9 @@ namespace eosio {
          using exec_action = eosio::action_wrapper<"exec"_n, &multisig::exec>;
          using invalidate_action = eosio::action_wrapper<"invalidate"_n, &multisig::invalidate>;
 
+         /// proposals requesting more permission levels than this store their approvals in one row per level
+         static constexpr size_t approval_rows_threshold = 32;
+
       private:
          struct [[eosio::table]] proposal {
             name                            proposal_name;
@@ -135,6 +141,17 @@ namespace eosio {
 
          typedef eosio::multi_index< "proposal"_n, proposal > proposals;
 
+         /// sha256 of the packed transaction of a proposal, kept apart so that approve does not read the transaction
+         struct [[eosio::table]] proposal_hash_info {
+            name                            proposal_name;
+            checksum256                     proposal_hash;
+
+            uint64_t primary_key()const { return proposal_name.value; }
+         };
+         typedef eosio::multi_index< "prophash"_n, proposal_hash_info > proposal_hashes;
+
+         void erase_proposal_hash( name proposer, name proposal_name );
+
          struct [[eosio::table]] old_approvals_info {
             name                            proposal_name;
             std::vector<permission_level>   requested_approvals;
@@ -162,6 +179,36 @@ namespace eosio {
          };
          typedef eosio::multi_index< "approvals2"_n, approvals_info > approvals;
 
+         struct [[eosio::table]] approvals_header {
+            name                    proposal_name;
+            uint32_t                requested_count = 0;
+            uint32_t                provided_count  = 0;
+
+            uint64_t primary_key()const { return proposal_name.value; }
+         };
+         typedef eosio::multi_index< "approvals3"_n, approvals_header > approvals_headers;
+
+         struct [[eosio::table]] approval_row {
+            uint64_t                id;
+            name                    proposal_name;
+            permission_level        level;
+            time_point              time;
+            bool                    provided = false;
+
+            uint64_t primary_key()const { return id; }
+            checksum256 by_level()const { return level_key( proposal_name, level ); }
+
+            static checksum256 level_key( name proposal_name, const permission_level& level ) {
+               return checksum256::make_from_word_sequence<uint64_t>( proposal_name.value, level.actor.value,
+                                                                      level.permission.value, 0ull );
+            }
+         };
+         typedef eosio::multi_index< "approvalrows"_n, approval_row,
+                                     indexed_by<"bylevel"_n, const_mem_fun<approval_row, checksum256, &approval_row::by_level>>
+                                   > approval_rows;
+
+         std::vector<approval> take_approval_rows( name proposer, name proposal_name );
+
          struct [[eosio::table]] invalidation {
             name         account;
             time_point   last_invalidation_time;
@@ -45,6 +45,34 @@ void multisig::propose( ignore<name> proposer,
       prop.proposal_name       = _proposal_name;
       prop.packed_transaction  = pkd_trans;
    });
+   proposal_hashes hashtable( get_self(), _proposer.value );
+   hashtable.emplace( _proposer, [&]( auto& h ) {
+      h.proposal_name = _proposal_name;
+      h.proposal_hash = eosio::sha256( pkd_trans.data(), pkd_trans.size() );
+   });
+
+   if ( _requested.size() > approval_rows_threshold ) {
+      approval_rows rows( get_self(), _proposer.value );
+      auto idx = rows.get_index<"bylevel"_n>();
+      uint32_t requested_count = 0;
+      for ( auto& level : _requested ) {
+         if ( idx.find( approval_row::level_key( _proposal_name, level ) ) != idx.end() ) continue;
+         const uint64_t id = rows.available_primary_key();
+         rows.emplace( _proposer, [&]( auto& r ) {
+            r.id            = id;
+            r.proposal_name = _proposal_name;
+            r.level         = level;
+            r.time          = time_point{ microseconds{0} };
+         });
+         ++requested_count;
+      }
+      approvals_headers hdrtable( get_self(), _proposer.value );
+      hdrtable.emplace( _proposer, [&]( auto& h ) {
+         h.proposal_name   = _proposal_name;
+         h.requested_count = requested_count;
+      });
+      return;
+   }
 
    approvals apptable( get_self(), _proposer.value );
    apptable.emplace( _proposer, [&]( auto& a ) {
@@ -62,9 +90,33 @@ void multisig::approve( name proposer, name proposal_name, permission_level leve
    require_auth( level );
 
    if( proposal_hash ) {
-      proposals proptable( get_self(), proposer.value );
-      auto& prop = proptable.get( proposal_name.value, "proposal not found" );
-      assert_sha256( prop.packed_transaction.data(), prop.packed_transaction.size(), *proposal_hash );
+      proposal_hashes hashtable( get_self(), proposer.value );
+      auto hash_it = hashtable.find( proposal_name.value );
+      // the transaction is only read and hashed for proposals made before the hash was stored, or to
+      // report a mismatch
+      if( hash_it == hashtable.end() || hash_it->proposal_hash != *proposal_hash ) {
+         proposals proptable( get_self(), proposer.value );
+         auto& prop = proptable.get( proposal_name.value, "proposal not found" );
+         assert_sha256( prop.packed_transaction.data(), prop.packed_transaction.size(), *proposal_hash );
+      }
+   }
+
+   approvals_headers hdrtable( get_self(), proposer.value );
+   auto hdr_it = hdrtable.find( proposal_name.value );
+   if ( hdr_it != hdrtable.end() ) {
+      approval_rows rows( get_self(), proposer.value );
+      auto idx = rows.get_index<"bylevel"_n>();
+      auto row_it = idx.find( approval_row::level_key( proposal_name, level ) );
+      check( row_it != idx.end() && !row_it->provided, "approval is not on the list of requested approvals" );
+      idx.modify( row_it, proposer, [&]( auto& r ) {
+            r.provided = true;
+            r.time     = current_time_point();
+         });
+      hdrtable.modify( hdr_it, proposer, [&]( auto& h ) {
+            --h.requested_count;
+            ++h.provided_count;
+         });
+      return;
    }
 
    approvals apptable( get_self(), proposer.value );
@@ -94,6 +146,24 @@ void multisig::approve( name proposer, name proposal_name, permission_level leve
 void multisig::unapprove( name proposer, name proposal_name, permission_level level ) {
    require_auth( level );
 
+   approvals_headers hdrtable( get_self(), proposer.value );
+   auto hdr_it = hdrtable.find( proposal_name.value );
+   if ( hdr_it != hdrtable.end() ) {
+      approval_rows rows( get_self(), proposer.value );
+      auto idx = rows.get_index<"bylevel"_n>();
+      auto row_it = idx.find( approval_row::level_key( proposal_name, level ) );
+      check( row_it != idx.end() && row_it->provided, "no approval previously granted" );
+      idx.modify( row_it, proposer, [&]( auto& r ) {
+            r.provided = false;
+            r.time     = current_time_point();
+         });
+      hdrtable.modify( hdr_it, proposer, [&]( auto& h ) {
+            ++h.requested_count;
+            --h.provided_count;
+         });
+      return;
+   }
+
    approvals apptable( get_self(), proposer.value );
    auto apps_it = apptable.find( proposal_name.value );
    if ( apps_it != apptable.end() ) {
@@ -125,11 +195,17 @@ void multisig::cancel( name proposer, name proposal_name, name canceler ) {
       check( unpack<transaction_header>( prop.packed_transaction ).expiration < eosio::time_point_sec(current_time_point()), "cannot cancel until expiration" );
    }
    proptable.erase(prop);
+   erase_proposal_hash( proposer, proposal_name );
 
    //remove from new table
+   approvals_headers hdrtable( get_self(), proposer.value );
+   auto hdr_it = hdrtable.find( proposal_name.value );
    approvals apptable( get_self(), proposer.value );
    auto apps_it = apptable.find( proposal_name.value );
-   if ( apps_it != apptable.end() ) {
+   if ( hdr_it != hdrtable.end() ) {
+      take_approval_rows( proposer, proposal_name );
+      hdrtable.erase(hdr_it);
+   } else if ( apps_it != apptable.end() ) {
       apptable.erase(apps_it);
    } else {
       old_approvals old_apptable( get_self(), proposer.value );
@@ -149,11 +225,22 @@ void multisig::exec( name proposer, name proposal_name, name executer ) {
    ds >> trx_header;
    check( trx_header.expiration >= eosio::time_point_sec(current_time_point()), "transaction expired" );
 
+   approvals_headers hdrtable( get_self(), proposer.value );
+   auto hdr_it = hdrtable.find( proposal_name.value );
    approvals apptable( get_self(), proposer.value );
    auto apps_it = apptable.find( proposal_name.value );
    std::vector<permission_level> approvals;
    invalidations inv_table( get_self(), get_self().value );
-   if ( apps_it != apptable.end() ) {
+   if ( hdr_it != hdrtable.end() ) {
+      approvals.reserve( hdr_it->provided_count );
+      for ( auto& p : take_approval_rows( proposer, proposal_name ) ) {
+         auto it = inv_table.find( p.level.actor.value );
+         if ( it == inv_table.end() || it->last_invalidation_time < p.time ) {
+            approvals.push_back(p.level);
+         }
+      }
+      hdrtable.erase(hdr_it);
+   } else if ( apps_it != apptable.end() ) {
       approvals.reserve( apps_it->provided_approvals.size() );
       for ( auto& p : apps_it->provided_approvals ) {
          auto it = inv_table.find( p.level.actor.value );
@@ -186,6 +273,7 @@ void multisig::exec( name proposer, name proposal_name, name executer ) {
                   prop.packed_transaction.data(), prop.packed_transaction.size() );
 
    proptable.erase(prop);
+   erase_proposal_hash( proposer, proposal_name );
 }
 
 void multisig::invalidate( name account ) {
@@ -204,4 +292,32 @@ void multisig::invalidate( name account ) {
    }
 }
 
+/**
+ * Erases the stored hash of a proposal, proposals made before the hash was stored have none
+ */
+void multisig::erase_proposal_hash( name proposer, name proposal_name ) {
+   proposal_hashes hashtable( get_self(), proposer.value );
+   auto hash_it = hashtable.find( proposal_name.value );
+   if ( hash_it != hashtable.end() ) {
+      hashtable.erase( hash_it );
+   }
+}
+
+/**
+ * Erases the approval rows of a proposal and returns the provided approvals among them
+ */
+std::vector<multisig::approval> multisig::take_approval_rows( name proposer, name proposal_name ) {
+   std::vector<approval> provided;
+   approval_rows rows( get_self(), proposer.value );
+   auto idx = rows.get_index<"bylevel"_n>();
+   auto row_it = idx.lower_bound( approval_row::level_key( proposal_name, permission_level{} ) );
+   while ( row_it != idx.end() && row_it->proposal_name == proposal_name ) {
+      if ( row_it->provided ) {
+         provided.push_back( approval{ row_it->level, row_it->time } );
+      }
+      row_it = idx.erase( row_it );
+   }
+   return provided;
+}
+
 } /// namespace eosio
@@ -8,6 +8,7 @@
 
 #include <eosio.system/exchange_state.hpp>
 #include <eosio.system/native.hpp>
+#include <eosio.system/write_back_cache.hpp>
 
 #include <deque>
 #include <optional>
@@ -71,7 +72,17 @@ namespace eosiosystem {
    static constexpr int64_t  inflation_pay_factor  = 5;                // 20% of the inflation
    static constexpr int64_t  votepay_factor        = 4;                // 25% of the producer pay
    static constexpr uint32_t refund_delay_sec      = 3 * seconds_per_day;
+   static constexpr int64_t  useconds_per_fill     = 3600 * 1000'000ll; // periodic inflation issuance interval
 
+   /**
+    * Optional behaviors of the system contract, each enabled or disabled on its own by `setfeature`
+    */
+   enum system_feature : uint64_t {
+      feature_periodic_inflation = 1ull << 0, ///< inflation is issued by `onblock` and `fillbuckets` instead of `claimrewards`
+      feature_lazy_refunds       = 1ull << 1, ///< matured refunds are settled without a deferred transaction
+      feature_lazy_bid_refunds   = 1ull << 2, ///< outbid amounts are paid without a deferred transaction
+      feature_partial_rex_fills  = 1ull << 3  ///< queued `sellrex` orders are filled partially
+   };
 
    /**
     *
@@ -137,6 +148,42 @@ namespace eosiosystem {
     */
    typedef eosio::multi_index< "bidrefunds"_n, bid_refund > bid_refund_table;
 
+   /**
+    * Pending bid refund of `bidder` for `newname`, queued in order of outbid so that outbid amounts can be
+    * paid without a deferred transaction, used once the `lazybidrefnd` feature is enabled
+    */
+   struct [[eosio::table, eosio::contract("eosio.system")]] bid_refund_queue_entry {
+      uint64_t     id;
+      name         bidder;
+      name         newname;
+
+      uint64_t  primary_key()const { return id; }
+      uint128_t by_bidder()const   { return (uint128_t(bidder.value) << 64) | newname.value; }
+
+      EOSLIB_SERIALIZE( bid_refund_queue_entry, (id)(bidder)(newname) )
+   };
+
+   typedef eosio::multi_index< "bidrefqueue"_n, bid_refund_queue_entry,
+                               indexed_by<"bybidder"_n, const_mem_fun<bid_refund_queue_entry, uint128_t, &bid_refund_queue_entry::by_bidder>>
+                             > bid_refund_queue_table;
+
+   /**
+    * Highest open name bid, kept up to date by `bidname` and by auction close so that `onblock` does not
+    * have to look it up in the `highbid` index. An empty `newname` means that there is no open bid.
+    */
+   struct [[eosio::table("topbid"), eosio::contract("eosio.system")]] top_name_bid {
+      name         newname;
+      int64_t      high_bid = 0;
+      time_point   last_bid_time;
+
+      EOSLIB_SERIALIZE( top_name_bid, (newname)(high_bid)(last_bid_time) )
+   };
+
+   /**
+    * Top name bid singleton
+    */
+   typedef eosio::singleton< "topbid"_n, top_name_bid > top_name_bid_singleton;
+
    /**
     * Defines new global state parameters.
     */
@@ -193,6 +240,33 @@ namespace eosiosystem {
       EOSLIB_SERIALIZE( eosio_global_state3, (last_vpay_state_update)(total_vpay_share_change_rate) )
    };
 
+   /**
+    * Defines new global state parameters added after version 1.8.0
+    */
+   struct [[eosio::table("global4"), eosio::contract("eosio.system")]] eosio_global_state4 {
+      eosio_global_state4() { }
+      uint64_t          last_proposed_schedule_fingerprint = 0; ///< order independent hash of the names and keys of the last accepted proposed producer schedule
+      uint64_t          features = 0; ///< bitset of the enabled `system_feature` flags
+
+      EOSLIB_SERIALIZE( eosio_global_state4, (last_proposed_schedule_fingerprint)(features) )
+   };
+
+   /**
+    * Blocks produced by `producer` that have not yet been added to its `producer_info::unpaid_blocks`.
+    *
+    * @details `onblock` increments the row of the block producer. The rows are added to the `producers` table
+    * and to `eosio_global_state::total_unpaid_blocks`, and erased, when the producer schedule is updated or
+    * when rewards are claimed.
+    */
+   struct [[eosio::table("unpaidblocks"), eosio::contract("eosio.system")]] producer_unpaid_blocks {
+      name              producer;
+      uint32_t          blocks = 0;
+
+      uint64_t primary_key()const { return producer.value; }
+
+      EOSLIB_SERIALIZE( producer_unpaid_blocks, (producer)(blocks) )
+   };
+
    /**
     * Defines `producer_info` structure to be stored in `producer_info` table, added after version 1.0
     */
@@ -295,6 +369,11 @@ namespace eosiosystem {
     */
    typedef eosio::multi_index< "producers2"_n, producer_info2 > producers_table2;
 
+   // voter and producer rows are cached in memory and written back once per action
+   typedef write_back_cache< voters_table, voter_info >         voters_cache;
+   typedef write_back_cache< producers_table, producer_info >   producers_cache;
+   typedef write_back_cache< producers_table2, producer_info2 > producers_cache2;
+
    /**
     * Global state singleton added in version 1.0
     */
@@ -307,6 +386,14 @@ namespace eosiosystem {
     * Global state singleton added in version 1.3
     */
    typedef eosio::singleton< "global3"_n, eosio_global_state3 > global_state3_singleton;
+   /**
+    * Global state singleton added in version 1.8.0
+    */
+   typedef eosio::singleton< "global4"_n, eosio_global_state4 > global_state4_singleton;
+   /**
+    * Unpaid block counters table
+    */
+   typedef eosio::multi_index< "unpaidblocks"_n, producer_unpaid_blocks > unpaid_blocks_table;
 
    struct [[eosio::table, eosio::contract("eosio.system")]] user_resources {
       name          owner;
@@ -338,6 +425,18 @@ namespace eosiosystem {
 
    };
 
+   /**
+    * Resources of an account imported by `importaccts`, the stake is delegated by the account to itself
+    */
+   struct import_account {
+      name          account;
+      int64_t       ram_bytes = 0;
+      asset         net_weight;
+      asset         cpu_weight;
+
+      EOSLIB_SERIALIZE( import_account, (account)(ram_bytes)(net_weight)(cpu_weight) )
+   };
+
    struct [[eosio::table, eosio::contract("eosio.system")]] refund_request {
       name            owner;
       time_point_sec  request_time;
@@ -351,6 +450,24 @@ namespace eosiosystem {
       EOSLIB_SERIALIZE( refund_request, (owner)(request_time)(net_amount)(cpu_amount) )
    };
 
+   /**
+    * Pending refund of `owner`, queued by request time so that matured refunds can be settled without
+    * a deferred transaction, used once the `lazyrefunds` feature is enabled
+    */
+   struct [[eosio::table, eosio::contract("eosio.system")]] refund_queue_entry {
+      name            owner;
+      time_point_sec  request_time;
+
+      uint64_t  primary_key()const { return owner.value; }
+      uint64_t  by_time()const     { return request_time.utc_seconds; }
+
+      EOSLIB_SERIALIZE( refund_queue_entry, (owner)(request_time) )
+   };
+
+   typedef eosio::multi_index< "refundqueue"_n, refund_queue_entry,
+                               indexed_by<"bytime"_n, const_mem_fun<refund_queue_entry, uint64_t, &refund_queue_entry::by_time>>
+                             > refund_queue_table;
+
    /**
     *  These tables are designed to be constructed in the scope of the relevant user, this
     *  facilitates simpler API for per-user queries
@@ -444,6 +561,9 @@ namespace eosiosystem {
     */
    typedef eosio::multi_index< "rexbal"_n, rex_balance > rex_balance_table;
 
+   // rex_balance rows are cached in memory and written back once per action
+   typedef write_back_cache< rex_balance_table, rex_balance > rex_balance_cache;
+
    /**
     * `rex_loan` structure underlying the `rex_cpu_loan_table` and `rex_net_loan_table`.
     *
@@ -515,12 +635,46 @@ namespace eosiosystem {
    typedef eosio::multi_index< "rexqueue"_n, rex_order,
                                indexed_by<"bytime"_n, const_mem_fun<rex_order, uint64_t, &rex_order::by_time>>> rex_order_table;
 
+   /**
+    * REX maintenance policy
+    *
+    * @details Number of expired CPU loans, expired NET loans and queued sellrex orders that user-facing
+    * REX actions process before doing their own work. With a budget of zero, the queues are only drained
+    * by `rexexec` crank transactions.
+    */
+   struct [[eosio::table("rexmaint"), eosio::contract("eosio.system")]] rex_maintenance {
+      uint16_t   action_budget = 2; /// maximum number of each of the three categories processed per REX action
+
+      EOSLIB_SERIALIZE( rex_maintenance, (action_budget) )
+   };
+
+   /**
+    * REX maintenance singleton
+    */
+   typedef eosio::singleton< "rexmaint"_n, rex_maintenance > rex_maintenance_singleton;
+
    struct rex_order_outcome {
       bool success;
       asset proceeds;
       asset stake_change;
    };
 
+   /**
+    * Change of a producer's total votes accumulated over one action, including the changes propagated
+    * through proxies.
+    */
+   struct producer_vote_delta {
+      name   producer;
+      double vote_weight = 0.0;   /// change of the producer's total votes
+      bool   new_vote    = false; /// producer is in the new set of producers voted for
+      bool   proxied     = false; /// change propagated through a proxy, the producer must exist
+   };
+
+   /**
+    * Flat set of producer vote changes, sorted by producer name and unique.
+    */
+   typedef std::vector<producer_vote_delta> producer_vote_deltas;
+
    /**
     * The EOSIO system contract.
     *
@@ -529,19 +683,29 @@ namespace eosiosystem {
    class [[eosio::contract("eosio.system")]] system_contract : public native {
 
       private:
-         voters_table            _voters;
-         producers_table         _producers;
-         producers_table2        _producers2;
+         voters_cache            _voters;
+         producers_cache         _producers;
+         producers_cache2        _producers2;
          global_state_singleton  _global;
          global_state2_singleton _global2;
          global_state3_singleton _global3;
+         global_state4_singleton _global4;
          eosio_global_state      _gstate;
          eosio_global_state2     _gstate2;
          eosio_global_state3     _gstate3;
+         eosio_global_state4     _gstate4;
+         bool                    _gstate_loaded  = false;
+         bool                    _gstate2_loaded = false;
+         bool                    _gstate3_loaded = false;
+         bool                    _gstate4_loaded = false;
+         bool                    _gstate_dirty   = false;
+         bool                    _gstate2_dirty  = false;
+         bool                    _gstate3_dirty  = false;
+         bool                    _gstate4_dirty  = false;
          rammarket               _rammarket;
          rex_pool_table          _rexpool;
          rex_fund_table          _rexfunds;
-         rex_balance_table       _rexbalance;
+         rex_balance_cache       _rexbalance;
          rex_order_table         _rexorders;
 
       public:
@@ -692,6 +856,41 @@ namespace eosiosystem {
          void delegatebw( const name& from, const name& receiver,
                           const asset& stake_net_quantity, const asset& stake_cpu_quantity, bool transfer );
 
+         /**
+          * Onboard action.
+          *
+          * @details Buys `ram_bytes` of ram for `receiver` and delegates `stake_net_quantity` and
+          * `stake_cpu_quantity` from `payer` to `receiver`, as `buyrambytes` followed by `delegatebw` would,
+          * but updating the receiver's resources and resource limits once. Meant to be sent right after
+          * `newaccount` in the transaction creating `receiver`.
+          *
+          * @param payer - the account paying for the ram and the stake,
+          * @param receiver - the account receiving the ram and the staked resources,
+          * @param ram_bytes - the quantity of ram to buy specified in bytes,
+          * @param stake_net_quantity - tokens staked for NET bandwidth,
+          * @param stake_cpu_quantity - tokens staked for CPU bandwidth,
+          * @param transfer - if true, ownership of staked tokens is transfered to `receiver`.
+          */
+         [[eosio::action]]
+         void onboard( const name& payer, const name& receiver, uint32_t ram_bytes,
+                       const asset& stake_net_quantity, const asset& stake_cpu_quantity, bool transfer );
+
+         /**
+          * Import accounts action.
+          *
+          * @details Gives existing accounts ram and self-delegated stake in bulk, e.g. when migrating accounts
+          * to a new chain. The ram is bought by the system account at the current market price without
+          * fee, the stake is paid by the system account. Each account's `userres`, `delband` and `voters`
+          * rows are written once and billed to the account, as for `delegatebw`, and the global state, the
+          * ram market and the token transfers once per call.
+          *
+          * @param accounts - the accounts to import and their ram bytes, NET and CPU stake.
+          *
+          * @pre Requires authority of the system account.
+          */
+         [[eosio::action]]
+         void importaccts( const std::vector<import_account>& accounts );
+
          /**
           * Setrex action.
           *
@@ -701,6 +900,17 @@ namespace eosiosystem {
          [[eosio::action]]
          void setrex( const asset& balance );
 
+         /**
+          * Set REX maintenance action.
+          *
+          * @details Sets the number of expired CPU loans, expired NET loans and queued sellrex orders
+          * processed by each user-facing REX action. Queues beyond this budget are drained by `rexexec`.
+          *
+          * @param action_budget - number of each of CPU loans, NET loans, and sell orders to be processed.
+          */
+         [[eosio::action]]
+         void setrexmaint( uint16_t action_budget );
+
          /**
           * Deposit to REX fund action.
           *
@@ -789,7 +999,9 @@ namespace eosiosystem {
          /**
           * Cnclrexorder action.
           *
-          * @details Cancels unfilled REX sell order by owner if one exists.
+          * @details Cancels unfilled REX sell order by owner if one exists. Once the `partialfills` feature is
+          * enabled queued orders may be partially filled, the proceeds of these partial fills are transferred
+          * to owner's REX fund.
           *
           * @param owner - owner account name.
           *
@@ -914,6 +1126,29 @@ namespace eosiosystem {
          [[eosio::action]]
          void rexexec( const name& user, uint16_t max );
 
+         /**
+          * Quote rent action.
+          *
+          * @details Computes the tokens `rentcpu` or `rentnet` would currently stake for `loan_payment`.
+          * Nothing is written, the quote is sent to `rex.results` as a `quoteresult` action.
+          *
+          * @param loan_payment - tokens paid for the loan.
+          */
+         [[eosio::action]]
+         void quoterent( const asset& loan_payment );
+
+         /**
+          * Quote sell rex action.
+          *
+          * @details Computes the proceeds of selling `rex` at the current REX price. Whether the order can be
+          * filled immediately is not taken into account. Nothing is written, the quote is sent to `rex.results`
+          * as a `quoteresult` action.
+          *
+          * @param rex - amount of REX to be sold.
+          */
+         [[eosio::action]]
+         void quotesellrex( const asset& rex );
+
          /**
           * Consolidate action.
           *
@@ -1039,6 +1274,28 @@ namespace eosiosystem {
          [[eosio::action]]
          void sellram( const name& account, int64_t bytes );
 
+         /**
+          * Quote buy ram action.
+          *
+          * @details Computes the ram bytes `buyram` would currently reserve for `quant`, after the ram fee.
+          * Nothing is written, the quote is sent to `rex.results` as a `quoteresult` action.
+          *
+          * @param quant - the quantity of tokens to buy ram with.
+          */
+         [[eosio::action]]
+         void quotebuyram( const asset& quant );
+
+         /**
+          * Quote sell ram action.
+          *
+          * @details Computes the tokens `sellram` would currently pay for `bytes`, after the ram fee.
+          * Nothing is written, the quote is sent to `rex.results` as a `quoteresult` action.
+          *
+          * @param bytes - the amount of ram to sell in bytes.
+          */
+         [[eosio::action]]
+         void quotesellram( int64_t bytes );
+
          /**
           * Refund action.
           *
@@ -1050,6 +1307,19 @@ namespace eosiosystem {
          [[eosio::action]]
          void refund( const name& owner );
 
+         /**
+          * Settle refunds action.
+          *
+          * @details Once the `lazyrefunds` feature is enabled unstaked tokens are not returned by a deferred
+          * transaction. Matured refunds are settled by the owner's next `delegatebw` or `undelegatebw`, by
+          * `refund`, or by this action, which pays out up to `max` matured refunds in order of request time.
+          *
+          * @param user - any account can execute this action,
+          * @param max - maximum number of refunds to be settled.
+          */
+         [[eosio::action]]
+         void settlerefund( const name& user, uint16_t max );
+
          // functions defined in voting.cpp
 
          /**
@@ -1167,6 +1437,19 @@ namespace eosiosystem {
          [[eosio::action]]
          void claimrewards( const name& owner );
 
+         /**
+          * Fill buckets action.
+          *
+          * @details Issues the inflation accumulated since the last fill and distributes it to the savings,
+          * per-block and per-vote buckets, if the last fill is at least one hour old. Once the `perinflation`
+          * feature is enabled the buckets are filled by `onblock` and this action, and `claimrewards` only pays
+          * out of them.
+          *
+          * @param user - any account can execute this action.
+          */
+         [[eosio::action]]
+         void fillbuckets( const name& user );
+
          /**
           * Set privilege status for an account.
           *
@@ -1198,6 +1481,22 @@ namespace eosiosystem {
          [[eosio::action]]
          void updtrevision( uint8_t revision );
 
+         /**
+          * Set feature action.
+          *
+          * @details Enables or disables one optional behavior of the system contract, independently of
+          * the other features and of the revision.
+          *
+          * @param feature - the feature name, one of:
+          *    - `perinflation`, inflation issued periodically instead of by `claimrewards`,
+          *    - `lazyrefunds`, matured refunds settled without deferred transactions,
+          *    - `lazybidrefnd`, outbid amounts paid without deferred transactions,
+          *    - `partialfills`, queued sellrex orders filled partially,
+          * @param enabled - true to enable the feature, false to disable it.
+          */
+         [[eosio::action]]
+         void setfeature( const name& feature, bool enabled );
+
          /**
           * Bid name action.
           *
@@ -1230,12 +1529,28 @@ namespace eosiosystem {
          [[eosio::action]]
          void bidrefund( const name& bidder, const name& newname );
 
+         /**
+          * Settle bid refunds action.
+          *
+          * @details Once the `lazybidrefnd` feature is enabled an outbid amount is not returned by a deferred
+          * transaction. It is kept in the bid refunds table and paid out by `bidrefund`, netted against the
+          * bidder's next `bidname`, or paid by this action, which settles up to `max` bid refunds in the order
+          * they were outbid.
+          *
+          * @param user - any account can execute this action,
+          * @param max - maximum number of bid refunds to be settled.
+          */
+         [[eosio::action]]
+         void settlebids( const name& user, uint16_t max );
+
          using init_action = eosio::action_wrapper<"init"_n, &system_contract::init>;
          using setacctram_action = eosio::action_wrapper<"setacctram"_n, &system_contract::setacctram>;
          using setacctnet_action = eosio::action_wrapper<"setacctnet"_n, &system_contract::setacctnet>;
          using setacctcpu_action = eosio::action_wrapper<"setacctcpu"_n, &system_contract::setacctcpu>;
          using activate_action = eosio::action_wrapper<"activate"_n, &system_contract::activate>;
          using delegatebw_action = eosio::action_wrapper<"delegatebw"_n, &system_contract::delegatebw>;
+         using onboard_action = eosio::action_wrapper<"onboard"_n, &system_contract::onboard>;
+         using importaccts_action = eosio::action_wrapper<"importaccts"_n, &system_contract::importaccts>;
          using deposit_action = eosio::action_wrapper<"deposit"_n, &system_contract::deposit>;
          using withdraw_action = eosio::action_wrapper<"withdraw"_n, &system_contract::withdraw>;
          using buyrex_action = eosio::action_wrapper<"buyrex"_n, &system_contract::buyrex>;
@@ -1250,7 +1565,10 @@ namespace eosiosystem {
          using defnetloan_action = eosio::action_wrapper<"defnetloan"_n, &system_contract::defnetloan>;
          using updaterex_action = eosio::action_wrapper<"updaterex"_n, &system_contract::updaterex>;
          using rexexec_action = eosio::action_wrapper<"rexexec"_n, &system_contract::rexexec>;
+         using quoterent_action = eosio::action_wrapper<"quoterent"_n, &system_contract::quoterent>;
+         using quotesellrex_action = eosio::action_wrapper<"quotesellrex"_n, &system_contract::quotesellrex>;
          using setrex_action = eosio::action_wrapper<"setrex"_n, &system_contract::setrex>;
+         using setrexmaint_action = eosio::action_wrapper<"setrexmaint"_n, &system_contract::setrexmaint>;
          using mvtosavings_action = eosio::action_wrapper<"mvtosavings"_n, &system_contract::mvtosavings>;
          using mvfrsavings_action = eosio::action_wrapper<"mvfrsavings"_n, &system_contract::mvfrsavings>;
          using consolidate_action = eosio::action_wrapper<"consolidate"_n, &system_contract::consolidate>;
@@ -1259,7 +1577,10 @@ namespace eosiosystem {
          using buyram_action = eosio::action_wrapper<"buyram"_n, &system_contract::buyram>;
          using buyrambytes_action = eosio::action_wrapper<"buyrambytes"_n, &system_contract::buyrambytes>;
          using sellram_action = eosio::action_wrapper<"sellram"_n, &system_contract::sellram>;
+         using quotebuyram_action = eosio::action_wrapper<"quotebuyram"_n, &system_contract::quotebuyram>;
+         using quotesellram_action = eosio::action_wrapper<"quotesellram"_n, &system_contract::quotesellram>;
          using refund_action = eosio::action_wrapper<"refund"_n, &system_contract::refund>;
+         using settlerefund_action = eosio::action_wrapper<"settlerefund"_n, &system_contract::settlerefund>;
          using regproducer_action = eosio::action_wrapper<"regproducer"_n, &system_contract::regproducer>;
          using unregprod_action = eosio::action_wrapper<"unregprod"_n, &system_contract::unregprod>;
          using setram_action = eosio::action_wrapper<"setram"_n, &system_contract::setram>;
@@ -1267,10 +1588,13 @@ namespace eosiosystem {
          using voteproducer_action = eosio::action_wrapper<"voteproducer"_n, &system_contract::voteproducer>;
          using regproxy_action = eosio::action_wrapper<"regproxy"_n, &system_contract::regproxy>;
          using claimrewards_action = eosio::action_wrapper<"claimrewards"_n, &system_contract::claimrewards>;
+         using fillbuckets_action = eosio::action_wrapper<"fillbuckets"_n, &system_contract::fillbuckets>;
          using rmvproducer_action = eosio::action_wrapper<"rmvproducer"_n, &system_contract::rmvproducer>;
          using updtrevision_action = eosio::action_wrapper<"updtrevision"_n, &system_contract::updtrevision>;
+         using setfeature_action = eosio::action_wrapper<"setfeature"_n, &system_contract::setfeature>;
          using bidname_action = eosio::action_wrapper<"bidname"_n, &system_contract::bidname>;
          using bidrefund_action = eosio::action_wrapper<"bidrefund"_n, &system_contract::bidrefund>;
+         using settlebids_action = eosio::action_wrapper<"settlebids"_n, &system_contract::settlebids>;
          using setpriv_action = eosio::action_wrapper<"setpriv"_n, &system_contract::setpriv>;
          using setalimits_action = eosio::action_wrapper<"setalimits"_n, &system_contract::setalimits>;
          using setparams_action = eosio::action_wrapper<"setparams"_n, &system_contract::setparams>;
@@ -1286,15 +1610,29 @@ namespace eosiosystem {
 
          //defined in eosio.system.cpp
          static eosio_global_state get_default_parameters();
+         // global state singletons are read on first use, only the ones written through
+         // the mutable accessors are saved on exit
+         const eosio_global_state&  gstate();
+         const eosio_global_state2& gstate2();
+         const eosio_global_state3& gstate3();
+         const eosio_global_state4& gstate4();
+         eosio_global_state&  mutable_gstate();
+         eosio_global_state2& mutable_gstate2();
+         eosio_global_state3& mutable_gstate3();
+         eosio_global_state4& mutable_gstate4();
+         bool feature_enabled( system_feature feature );
          symbol core_symbol()const;
          void update_ram_supply();
+         exchange_state get_ram_market();
 
          // defined in rex.cpp
          void runrex( uint16_t max );
+         uint16_t rex_action_budget()const;
          void update_resource_limits( const name& from, const name& receiver, int64_t delta_net, int64_t delta_cpu );
          void check_voting_requirement( const name& owner,
-                                        const char* error_msg = "must vote for at least 21 producers or for a proxy before buying REX" )const;
-         rex_order_outcome fill_rex_order( const rex_balance_table::const_iterator& bitr, const asset& rex );
+                                        const char* error_msg = "must vote for at least 21 producers or for a proxy before buying REX" );
+         rex_order_outcome fill_rex_order( const rex_balance& bal, const asset& rex );
+         asset get_fillable_rex( const asset& rex )const;
          asset update_rex_account( const name& owner, const asset& proceeds, const asset& unstake_quant, bool force_vote_update = false );
          void channel_to_rex( const name& from, const asset& amount );
          void channel_namebid_to_rex( const int64_t highest_bid );
@@ -1312,11 +1650,11 @@ namespace eosiosystem {
          static time_point_sec get_rex_maturity();
          asset add_to_rex_balance( const name& owner, const asset& payment, const asset& rex_received );
          asset add_to_rex_pool( const asset& payment );
-         void process_rex_maturities( const rex_balance_table::const_iterator& bitr );
-         void consolidate_rex_balance( const rex_balance_table::const_iterator& bitr,
+         void process_rex_maturities( const rex_balance& bal );
+         void consolidate_rex_balance( const rex_balance& bal,
                                        const asset& rex_in_sell_order );
-         int64_t read_rex_savings( const rex_balance_table::const_iterator& bitr );
-         void put_rex_savings( const rex_balance_table::const_iterator& bitr, int64_t rex );
+         int64_t read_rex_savings( const rex_balance& bal );
+         void put_rex_savings( const rex_balance& bal, int64_t rex );
          void update_rex_stake( const name& voter );
 
          void add_loan_to_rex_pool( const asset& payment, int64_t rented_tokens, bool new_loan );
@@ -1326,14 +1664,31 @@ namespace eosiosystem {
 
          // defined in delegate_bandwidth.cpp
          void changebw( name from, const name& receiver,
-                        const asset& stake_net_quantity, const asset& stake_cpu_quantity, bool transfer );
+                        const asset& stake_net_quantity, const asset& stake_cpu_quantity, bool transfer,
+                        int64_t ram_bytes_delta = 0 );
+         int64_t reserve_ram( const name& payer, const asset& quant );
+         bool settle_refund( const name& owner );
+         void update_refund_queue( const name& owner, const name& payer );
+         asset get_ram_cost( uint32_t bytes );
          void update_voting_power( const name& voter, const asset& total_update );
 
+         // defined in name_bidding.cpp
+         asset take_bid_refund( const name& bidder, const name& newname );
+         asset take_bid_refunds( const name& bidder );
+         void queue_bid_refund( const name& bidder, const name& newname, const name& payer );
+         top_name_bid get_top_name_bid( top_name_bid_singleton& top_sing );
+         static top_name_bid find_top_name_bid( name_bid_table& bids );
+
+         // defined in producer_pay.cpp
+         void flush_unpaid_blocks( unpaid_blocks_table& unpaid );
+         void fill_inflation_buckets( const time_point& ct );
+
          // defined in voting.hpp
          void update_elected_producers( const block_timestamp& timestamp );
          void update_votes( const name& voter, const name& proxy, const std::vector<name>& producers, bool voting );
-         void propagate_weight_change( const voter_info& voter );
-         double update_producer_votepay_share( const producers_table2::const_iterator& prod_itr,
+         void propagate_weight_change( const voter_info& voter, producer_vote_deltas& producer_deltas );
+         void update_producer_votes( const producer_vote_deltas& producer_deltas, bool voting );
+         double update_producer_votepay_share( const producer_info2& prod2,
                                                const time_point& ct,
                                                double shares_rate, bool reset_to_zero = false );
          double update_total_votepay_share( const time_point& ct,
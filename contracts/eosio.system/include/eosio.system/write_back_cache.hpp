@@ -0,0 +1,156 @@
+#pragma once
+
+#include <eosio/check.hpp>
+#include <eosio/multi_index.hpp>
+
+#include <map>
+#include <utility>
+
+namespace eosiosystem {
+
+   using eosio::check;
+   using eosio::name;
+   using eosio::same_payer;
+
+   /**
+    * @addtogroup eosiosystem
+    * @{
+    */
+
+   /**
+    * Write-back cache over a multi_index table.
+    *
+    * @details Rows are read from the table once per action and kept in memory. Modifications, insertions
+    * and ram payer changes are applied to the in-memory copy only, and each touched row is written back
+    * with a single `emplace` or `modify` when `flush` is called. Erasures are applied immediately.
+    * Rows are kept in a map keyed by primary key, so each lookup is logarithmic in the number of cached
+    * rows, and pointers to cached rows stay valid until the row is erased. Within an action, all access to
+    * the underlying table must go through the cache, or through `table`, which flushes pending changes first.
+    *
+    * @tparam Table - the multi_index type
+    * @tparam T - the row type of the table
+    */
+   template<typename Table, typename T>
+   class write_back_cache {
+      public:
+         write_back_cache( name code, uint64_t scope )
+         :_table( code, scope ) {}
+
+         write_back_cache( const write_back_cache& ) = delete;
+         write_back_cache& operator=( const write_back_cache& ) = delete;
+
+         /**
+          * Returns a pointer to the row with primary key `pk`, or nullptr if there is no such row.
+          */
+         const T* find( uint64_t pk ) {
+            if( auto i = find_item( pk ) )
+               return &i->row;
+
+            auto itr = _table.find( pk );
+            if( itr == _table.end() )
+               return nullptr;
+
+            return &_items.emplace( pk, item( *itr ) ).first->second.row;
+         }
+
+         const T* require_find( uint64_t pk, const char* error_msg = "unable to find key" ) {
+            auto row = find( pk );
+            check( row != nullptr, error_msg );
+            return row;
+         }
+
+         const T& get( uint64_t pk, const char* error_msg = "unable to find key" ) {
+            return *require_find( pk, error_msg );
+         }
+
+         /**
+          * Adds a new row, it is written to the table on flush with `payer` as ram payer.
+          */
+         template<typename Lambda>
+         const T& emplace( name payer, Lambda&& constructor ) {
+            check( payer != same_payer, "must specify a valid account to pay for new record" );
+            item i;
+            constructor( i.row );
+            const auto pk = i.row.primary_key();
+            check( find( pk ) == nullptr, "could not insert object, most likely a uniqueness constraint was violated" );
+            i.payer  = payer;
+            i.is_new = true;
+            _pending = true;
+            return _items.emplace( pk, std::move(i) ).first->second.row;
+         }
+
+         /**
+          * Updates a row previously returned by the cache, a `payer` other than `same_payer` changes the
+          * ram payer of the row when it is written back.
+          */
+         template<typename Lambda>
+         void modify( const T& obj, name payer, Lambda&& updater ) {
+            auto i = find_item( obj.primary_key() );
+            check( i != nullptr, "object passed to modify is not in write_back_cache" );
+            const auto pk = i->row.primary_key();
+            updater( i->row );
+            check( pk == i->row.primary_key(), "updater cannot change primary key when modifying an object" );
+            if( payer != same_payer )
+               i->payer = payer;
+            i->dirty = true;
+            _pending = true;
+         }
+
+         void erase( const T& obj ) {
+            auto it = _items.find( obj.primary_key() );
+            check( it != _items.end(), "object passed to erase is not in write_back_cache" );
+            if( !it->second.is_new )
+               _table.erase( _table.get( it->first ) );
+            _items.erase( it );
+         }
+
+         /**
+          * Writes all new and modified rows back to the table.
+          */
+         void flush() {
+            if( !_pending )
+               return;
+            for( auto& [pk, i] : _items ) {
+               if( i.is_new ) {
+                  _table.emplace( i.payer, [&]( auto& r ) { r = i.row; } );
+               } else if( i.dirty ) {
+                  _table.modify( _table.get( pk ), i.payer, [&]( auto& r ) { r = i.row; } );
+               }
+               i.payer  = same_payer;
+               i.is_new = false;
+               i.dirty  = false;
+            }
+            _pending = false;
+         }
+
+         /**
+          * Underlying table, pending changes are flushed first so that it can be read directly.
+          */
+         Table& table() {
+            flush();
+            return _table;
+         }
+
+      private:
+         struct item {
+            item() = default;
+            explicit item( const T& r ) : row(r) {}
+
+            T     row;
+            name  payer;            // ram payer applied on write back, same_payer keeps the current one
+            bool  is_new = false;   // row has not been written to the table yet
+            bool  dirty  = false;
+         };
+
+         item* find_item( uint64_t pk ) {
+            auto it = _items.find( pk );
+            return it != _items.end() ? &it->second : nullptr;
+         }
+
+         Table                      _table;
+         std::map<uint64_t, item>   _items;
+         bool                       _pending = false;   // some rows are new or modified since the last flush
+   };
+
+   /** @}*/ // end of @addtogroup eosiosystem
+}
@@ -6,6 +6,7 @@
 #include <eosio/transaction.hpp>
 
 #include <eosio.system/eosio.system.hpp>
+#include <eosio.system/rex.results.hpp>
 #include <eosio.token/eosio.token.hpp>
 
 #include "name_bidding.cpp"
@@ -26,12 +27,16 @@ namespace eosiosystem {
     *  This action will buy an exact amount of ram and bill the payer the current market price.
     */
    void system_contract::buyrambytes( const name& payer, const name& receiver, uint32_t bytes ) {
+      buyram( payer, receiver, get_ram_cost( bytes ) );
+   }
+
+   asset system_contract::get_ram_cost( uint32_t bytes ) {
       auto itr = _rammarket.find(ramcore_symbol.raw());
       const int64_t ram_reserve   = itr->base.balance.amount;
       const int64_t eos_reserve   = itr->quote.balance.amount;
       const int64_t cost          = exchange_state::get_bancor_input( ram_reserve, eos_reserve, bytes );
       const int64_t cost_plus_fee = cost / double(0.995);
-      buyram( payer, receiver, asset{ cost_plus_fee, core_symbol() } );
+      return asset{ cost_plus_fee, core_symbol() };
    }
 
 
@@ -46,6 +51,38 @@ namespace eosiosystem {
    void system_contract::buyram( const name& payer, const name& receiver, const asset& quant )
    {
       require_auth( payer );
+
+      const int64_t bytes_out = reserve_ram( payer, quant );
+
+      user_resources_table  userres( get_self(), receiver.value );
+      auto res_itr = userres.find( receiver.value );
+      if( res_itr ==  userres.end() ) {
+         res_itr = userres.emplace( receiver, [&]( auto& res ) {
+               res.owner = receiver;
+               res.net_weight = asset( 0, core_symbol() );
+               res.cpu_weight = asset( 0, core_symbol() );
+               res.ram_bytes = bytes_out;
+            });
+      } else {
+         userres.modify( res_itr, receiver, [&]( auto& res ) {
+               res.ram_bytes += bytes_out;
+            });
+      }
+
+      auto voter_itr = _voters.find( res_itr->owner.value );
+      if( voter_itr == nullptr || !has_field( voter_itr->flags1, voter_info::flags1_fields::ram_managed ) ) {
+         int64_t ram_bytes, net, cpu;
+         get_resource_limits( res_itr->owner, ram_bytes, net, cpu );
+         set_resource_limits( res_itr->owner, res_itr->ram_bytes + ram_gift_bytes, net, cpu );
+      }
+   }
+
+   /**
+    *  Transfers quant from payer to the ram and ramfee accounts and reserves the bought bytes
+    *  in the ram market, the receiver's user resources are left to the caller.
+    */
+   int64_t system_contract::reserve_ram( const name& payer, const asset& quant )
+   {
       update_ram_supply();
 
       check( quant.symbol == core_symbol(), "must buy ram with core token" );
@@ -79,30 +116,11 @@ namespace eosiosystem {
 
       check( bytes_out > 0, "must reserve a positive amount" );
 
-      _gstate.total_ram_bytes_reserved += uint64_t(bytes_out);
-      _gstate.total_ram_stake          += quant_after_fee.amount;
+      auto& gs = mutable_gstate();
+      gs.total_ram_bytes_reserved += uint64_t(bytes_out);
+      gs.total_ram_stake          += quant_after_fee.amount;
 
-      user_resources_table  userres( get_self(), receiver.value );
-      auto res_itr = userres.find( receiver.value );
-      if( res_itr ==  userres.end() ) {
-         res_itr = userres.emplace( receiver, [&]( auto& res ) {
-               res.owner = receiver;
-               res.net_weight = asset( 0, core_symbol() );
-               res.cpu_weight = asset( 0, core_symbol() );
-               res.ram_bytes = bytes_out;
-            });
-      } else {
-         userres.modify( res_itr, receiver, [&]( auto& res ) {
-               res.ram_bytes += bytes_out;
-            });
-      }
-
-      auto voter_itr = _voters.find( res_itr->owner.value );
-      if( voter_itr == _voters.end() || !has_field( voter_itr->flags1, voter_info::flags1_fields::ram_managed ) ) {
-         int64_t ram_bytes, net, cpu;
-         get_resource_limits( res_itr->owner, ram_bytes, net, cpu );
-         set_resource_limits( res_itr->owner, res_itr->ram_bytes + ram_gift_bytes, net, cpu );
-      }
+      return bytes_out;
    }
 
   /**
@@ -131,18 +149,19 @@ namespace eosiosystem {
 
       check( tokens_out.amount > 1, "token amount received from selling ram is too low" );
 
-      _gstate.total_ram_bytes_reserved -= static_cast<decltype(_gstate.total_ram_bytes_reserved)>(bytes); // bytes > 0 is asserted above
-      _gstate.total_ram_stake          -= tokens_out.amount;
+      auto& gs = mutable_gstate();
+      gs.total_ram_bytes_reserved -= static_cast<decltype(gs.total_ram_bytes_reserved)>(bytes); // bytes > 0 is asserted above
+      gs.total_ram_stake          -= tokens_out.amount;
 
       //// this shouldn't happen, but just in case it does we should prevent it
-      check( _gstate.total_ram_stake >= 0, "error, attempt to unstake more tokens than previously staked" );
+      check( gs.total_ram_stake >= 0, "error, attempt to unstake more tokens than previously staked" );
 
       userres.modify( res_itr, account, [&]( auto& res ) {
           res.ram_bytes -= bytes;
       });
 
       auto voter_itr = _voters.find( res_itr->owner.value );
-      if( voter_itr == _voters.end() || !has_field( voter_itr->flags1, voter_info::flags1_fields::ram_managed ) ) {
+      if( voter_itr == nullptr || !has_field( voter_itr->flags1, voter_info::flags1_fields::ram_managed ) ) {
          int64_t ram_bytes, net, cpu;
          get_resource_limits( res_itr->owner, ram_bytes, net, cpu );
          set_resource_limits( res_itr->owner, res_itr->ram_bytes + ram_gift_bytes, net, cpu );
@@ -161,6 +180,31 @@ namespace eosiosystem {
       }
    }
 
+   void system_contract::quotebuyram( const asset& quant ) {
+      check( quant.symbol == core_symbol(), "must buy ram with core token" );
+      check( quant.amount > 0, "must purchase a positive amount" );
+
+      auto quant_after_fee = quant;
+      quant_after_fee.amount -= ( quant.amount + 199 ) / 200; /// .5% fee (round up)
+
+      auto market = get_ram_market();
+      const asset bytes_out = market.direct_convert( quant_after_fee, ram_symbol );
+
+      rex_results::quoteresult_action quote_act( rex_account, std::vector<eosio::permission_level>{ } );
+      quote_act.send( bytes_out );
+   }
+
+   void system_contract::quotesellram( int64_t bytes ) {
+      check( bytes > 0, "cannot sell negative byte" );
+
+      auto market = get_ram_market();
+      asset tokens_out = market.direct_convert( asset(bytes, ram_symbol), core_symbol() );
+      tokens_out.amount -= ( tokens_out.amount + 199 ) / 200; /// .5% fee (round up)
+
+      rex_results::quoteresult_action quote_act( rex_account, std::vector<eosio::permission_level>{ } );
+      quote_act.send( tokens_out );
+   }
+
    void validate_b1_vesting( int64_t stake ) {
       const int64_t base_time = 1527811200; /// 2018-06-01
       const int64_t max_claimable = 100'000'000'0000ll;
@@ -170,7 +214,8 @@ namespace eosiosystem {
    }
 
    void system_contract::changebw( name from, const name& receiver,
-                                   const asset& stake_net_delta, const asset& stake_cpu_delta, bool transfer )
+                                   const asset& stake_net_delta, const asset& stake_cpu_delta, bool transfer,
+                                   int64_t ram_bytes_delta )
    {
       require_auth( from );
       check( stake_net_delta.amount != 0 || stake_cpu_delta.amount != 0, "should stake non-zero amount" );
@@ -178,6 +223,12 @@ namespace eosiosystem {
              >= std::max( std::abs( stake_net_delta.amount ), std::abs( stake_cpu_delta.amount ) ),
              "net and cpu deltas cannot be opposite signs" );
 
+      // with lazy refunds matured refunds are settled by the owner's next change of stake
+      const bool lazy_refunds = feature_enabled( feature_lazy_refunds );
+      if ( lazy_refunds && settle_refund( from ) ) {
+         update_refund_queue( from, from );
+      }
+
       name source_stake_from = from;
       if ( transfer ) {
          from = receiver;
@@ -217,11 +268,15 @@ namespace eosiosystem {
                   tot.owner = receiver;
                   tot.net_weight    = stake_net_delta;
                   tot.cpu_weight    = stake_cpu_delta;
+                  tot.ram_bytes     = ram_bytes_delta;
                });
          } else {
-            totals_tbl.modify( tot_itr, from == receiver ? from : same_payer, [&]( auto& tot ) {
+            // bought ram is billed to the receiver, as in buyram
+            const name payer = ram_bytes_delta > 0 ? receiver : from == receiver ? from : same_payer;
+            totals_tbl.modify( tot_itr, payer, [&]( auto& tot ) {
                   tot.net_weight    += stake_net_delta;
                   tot.cpu_weight    += stake_cpu_delta;
+                  tot.ram_bytes     += ram_bytes_delta;
                });
          }
          check( 0 <= tot_itr->net_weight.amount, "insufficient staked total net bandwidth" );
@@ -233,13 +288,13 @@ namespace eosiosystem {
             bool cpu_managed = false;
 
             auto voter_itr = _voters.find( receiver.value );
-            if( voter_itr != _voters.end() ) {
+            if( voter_itr != nullptr ) {
                ram_managed = has_field( voter_itr->flags1, voter_info::flags1_fields::ram_managed );
                net_managed = has_field( voter_itr->flags1, voter_info::flags1_fields::net_managed );
                cpu_managed = has_field( voter_itr->flags1, voter_info::flags1_fields::cpu_managed );
             }
 
-            if( !(net_managed && cpu_managed) ) {
+            if( !(net_managed && cpu_managed) || (ram_bytes_delta != 0 && !ram_managed) ) {
                int64_t ram_bytes, net, cpu;
                get_resource_limits( receiver, ram_bytes, net, cpu );
 
@@ -264,6 +319,7 @@ namespace eosiosystem {
          auto net_balance = stake_net_delta;
          auto cpu_balance = stake_cpu_delta;
          bool need_deferred_trx = false;
+         bool refund_erased     = false;
 
 
          // net and cpu are same sign by assertions in delegatebw and undelegatebw
@@ -299,6 +355,7 @@ namespace eosiosystem {
                if ( req->is_empty() ) {
                   refunds_tbl.erase( req );
                   need_deferred_trx = false;
+                  refund_erased     = true;
                } else {
                   need_deferred_trx = true;
                }
@@ -323,7 +380,12 @@ namespace eosiosystem {
             } // else stake increase requested with no existing row in refunds_tbl -> nothing to do with refunds_tbl
          } /// end if is_delegating_to_self || is_undelegating
 
-         if ( need_deferred_trx ) {
+         if ( lazy_refunds ) {
+            if ( need_deferred_trx || refund_erased ) {
+               update_refund_queue( from, from );
+               eosio::cancel_deferred( from.value ); // refund transaction sent before lazy refunds were enabled
+            }
+         } else if ( need_deferred_trx ) {
             eosio::transaction out;
             out.actions.emplace_back( permission_level{from, active_permission},
                                       get_self(), "refund"_n,
@@ -350,13 +412,13 @@ namespace eosiosystem {
    void system_contract::update_voting_power( const name& voter, const asset& total_update )
    {
       auto voter_itr = _voters.find( voter.value );
-      if( voter_itr == _voters.end() ) {
-         voter_itr = _voters.emplace( voter, [&]( auto& v ) {
+      if( voter_itr == nullptr ) {
+         voter_itr = &_voters.emplace( voter, [&]( auto& v ) {
             v.owner  = voter;
             v.staked = total_update.amount;
          });
       } else {
-         _voters.modify( voter_itr, same_payer, [&]( auto& v ) {
+         _voters.modify( *voter_itr, same_payer, [&]( auto& v ) {
             v.staked += total_update.amount;
          });
       }
@@ -385,6 +447,129 @@ namespace eosiosystem {
       changebw( from, receiver, stake_net_quantity, stake_cpu_quantity, transfer);
    } // delegatebw
 
+   void system_contract::onboard( const name& payer, const name& receiver, uint32_t ram_bytes,
+                                  const asset& stake_net_quantity, const asset& stake_cpu_quantity, bool transfer )
+   {
+      require_auth( payer );
+
+      asset zero_asset( 0, core_symbol() );
+      check( ram_bytes > 0, "must purchase a positive amount" );
+      check( stake_cpu_quantity >= zero_asset, "must stake a positive amount" );
+      check( stake_net_quantity >= zero_asset, "must stake a positive amount" );
+      check( stake_net_quantity.amount + stake_cpu_quantity.amount > 0, "must stake a positive amount" );
+      check( !transfer || payer != receiver, "cannot use transfer flag if delegating to self" );
+
+      const int64_t bytes_out = reserve_ram( payer, get_ram_cost( ram_bytes ) );
+      changebw( payer, receiver, stake_net_quantity, stake_cpu_quantity, transfer, bytes_out );
+   }
+
+   void system_contract::importaccts( const std::vector<import_account>& accounts )
+   {
+      require_auth( get_self() );
+      check( !accounts.empty(), "no accounts to import" );
+
+      update_ram_supply();
+
+      int64_t total_ram_bytes = 0;
+      asset   total_stake( 0, core_symbol() );
+      for( const auto& a : accounts ) {
+         check( is_account( a.account ), "account does not exist" );
+         check( a.net_weight.symbol == core_symbol() && a.cpu_weight.symbol == core_symbol(), "must stake core token" );
+         check( 0 <= a.net_weight.amount && 0 <= a.cpu_weight.amount, "must stake a positive amount" );
+         check( 0 <= a.ram_bytes, "must purchase a positive amount" );
+         check( uint64_t(a.ram_bytes) <= gstate().max_ram_size, "cannot import more ram than max ram size" );
+         check( a.ram_bytes <= std::numeric_limits<int64_t>::max() - total_ram_bytes, "overflow in total ram bytes" );
+         total_ram_bytes += a.ram_bytes;
+         total_stake     += a.net_weight + a.cpu_weight;
+      }
+
+      // buy the ram of all accounts with a single conversion
+      if( total_ram_bytes > 0 ) {
+         const auto& market = _rammarket.get(ramcore_symbol.raw(), "ram market does not exist");
+         check( total_ram_bytes < market.base.balance.amount, "insufficient ram in market" );
+         const int64_t cost = exchange_state::get_bancor_input( market.base.balance.amount, market.quote.balance.amount, total_ram_bytes );
+         check( 0 < cost, "ram cost must be positive" );
+         _rammarket.modify( market, same_payer, [&]( auto& es ) {
+            es.base.balance.amount  -= total_ram_bytes;
+            es.quote.balance.amount += cost;
+         });
+
+         auto& gs = mutable_gstate();
+         gs.total_ram_bytes_reserved += uint64_t(total_ram_bytes);
+         gs.total_ram_stake          += cost;
+
+         token::transfer_action transfer_act{ token_account, { {get_self(), active_permission} } };
+         transfer_act.send( get_self(), ram_account, asset(cost, core_symbol()), "import ram" );
+      }
+      if( total_stake.amount > 0 ) {
+         token::transfer_action transfer_act{ token_account, { {get_self(), active_permission} } };
+         transfer_act.send( get_self(), stake_account, total_stake, "import stake" );
+      }
+
+      for( const auto& a : accounts ) {
+         if( a.net_weight.amount > 0 || a.cpu_weight.amount > 0 ) {
+            del_bandwidth_table del_tbl( get_self(), a.account.value );
+            auto itr = del_tbl.find( a.account.value );
+            if( itr == del_tbl.end() ) {
+               del_tbl.emplace( a.account, [&]( auto& dbo ) {
+                  dbo.from       = a.account;
+                  dbo.to         = a.account;
+                  dbo.net_weight = a.net_weight;
+                  dbo.cpu_weight = a.cpu_weight;
+               });
+            } else {
+               del_tbl.modify( itr, same_payer, [&]( auto& dbo ) {
+                  dbo.net_weight += a.net_weight;
+                  dbo.cpu_weight += a.cpu_weight;
+               });
+            }
+         }
+
+         user_resources_table totals_tbl( get_self(), a.account.value );
+         auto tot_itr = totals_tbl.find( a.account.value );
+         if( tot_itr == totals_tbl.end() ) {
+            tot_itr = totals_tbl.emplace( a.account, [&]( auto& tot ) {
+               tot.owner      = a.account;
+               tot.net_weight = a.net_weight;
+               tot.cpu_weight = a.cpu_weight;
+               tot.ram_bytes  = a.ram_bytes;
+            });
+         } else {
+            totals_tbl.modify( tot_itr, same_payer, [&]( auto& tot ) {
+               tot.net_weight += a.net_weight;
+               tot.cpu_weight += a.cpu_weight;
+               tot.ram_bytes  += a.ram_bytes;
+            });
+         }
+
+         bool ram_managed = false;
+         bool net_managed = false;
+         bool cpu_managed = false;
+
+         auto voter_itr = _voters.find( a.account.value );
+         if( voter_itr != nullptr ) {
+            ram_managed = has_field( voter_itr->flags1, voter_info::flags1_fields::ram_managed );
+            net_managed = has_field( voter_itr->flags1, voter_info::flags1_fields::net_managed );
+            cpu_managed = has_field( voter_itr->flags1, voter_info::flags1_fields::cpu_managed );
+         }
+
+         if( !(ram_managed && net_managed && cpu_managed) ) {
+            int64_t ram_bytes, net, cpu;
+            get_resource_limits( a.account, ram_bytes, net, cpu );
+
+            set_resource_limits( a.account,
+                                 ram_managed ? ram_bytes : std::max( tot_itr->ram_bytes + ram_gift_bytes, ram_bytes ),
+                                 net_managed ? net : tot_itr->net_weight.amount,
+                                 cpu_managed ? cpu : tot_itr->cpu_weight.amount );
+         }
+
+         if( a.net_weight.amount > 0 || a.cpu_weight.amount > 0 ) {
+            vote_stake_updater( a.account );
+            update_voting_power( a.account, a.net_weight + a.cpu_weight );
+         }
+      }
+   }
+
    void system_contract::undelegatebw( const name& from, const name& receiver,
                                        const asset& unstake_net_quantity, const asset& unstake_cpu_quantity )
    {
@@ -392,7 +577,7 @@ namespace eosiosystem {
       check( unstake_cpu_quantity >= zero_asset, "must unstake a positive amount" );
       check( unstake_net_quantity >= zero_asset, "must unstake a positive amount" );
       check( unstake_cpu_quantity.amount + unstake_net_quantity.amount > 0, "must unstake a positive amount" );
-      check( _gstate.total_activated_stake >= min_activated_stake,
+      check( gstate().total_activated_stake >= min_activated_stake,
              "cannot undelegate bandwidth until the chain is activated (at least 15% of all tokens participate in voting)" );
 
       changebw( from, receiver, -unstake_net_quantity, -unstake_cpu_quantity, false);
@@ -410,6 +595,78 @@ namespace eosiosystem {
       token::transfer_action transfer_act{ token_account, { {stake_account, active_permission}, {req->owner, active_permission} } };
       transfer_act.send( stake_account, req->owner, req->net_amount + req->cpu_amount, "unstake" );
       refunds_tbl.erase( req );
+      update_refund_queue( owner, owner );
+   }
+
+   void system_contract::settlerefund( const name& user, uint16_t max ) {
+      require_auth( user );
+      check( feature_enabled( feature_lazy_refunds ), "refunds are settled by deferred transactions unless lazy refunds are enabled" );
+
+      refund_queue_table queue( get_self(), get_self().value );
+      auto idx = queue.get_index<"bytime"_n>();
+      const auto now = current_time_point();
+      for ( uint16_t i = 0; i < max; ++i ) {
+         auto itr = idx.begin();
+         if ( itr == idx.end() || now < itr->request_time + seconds(refund_delay_sec) ) break;
+
+         if ( settle_refund( itr->owner ) ) {
+            idx.erase( itr );
+         } else {
+            // refund row was removed or renewed since the entry was queued
+            refunds_table refunds_tbl( get_self(), itr->owner.value );
+            auto req = refunds_tbl.find( itr->owner.value );
+            if ( req == refunds_tbl.end() ) {
+               idx.erase( itr );
+            } else {
+               idx.modify( itr, same_payer, [&]( auto& q ) {
+                  q.request_time = req->request_time;
+               });
+            }
+         }
+      }
+   }
+
+   /**
+    * Pays out the refund of `owner` if it has matured, the transfer is authorized by the stake account
+    * only so that anyone can settle it. The refund queue is left to the caller.
+    *
+    * @return true if a refund was paid out
+    */
+   bool system_contract::settle_refund( const name& owner ) {
+      refunds_table refunds_tbl( get_self(), owner.value );
+      auto req = refunds_tbl.find( owner.value );
+      if ( req == refunds_tbl.end() || current_time_point() < req->request_time + seconds(refund_delay_sec) )
+         return false;
+
+      token::transfer_action transfer_act{ token_account, { {stake_account, active_permission} } };
+      transfer_act.send( stake_account, req->owner, req->net_amount + req->cpu_amount, "unstake" );
+      refunds_tbl.erase( req );
+      return true;
+   }
+
+   /**
+    * Keeps the refund queue entry of `owner` in line with its refund row
+    */
+   void system_contract::update_refund_queue( const name& owner, const name& payer ) {
+      refunds_table refunds_tbl( get_self(), owner.value );
+      auto req = refunds_tbl.find( owner.value );
+
+      refund_queue_table queue( get_self(), get_self().value );
+      auto qitr = queue.find( owner.value );
+      if ( req == refunds_tbl.end() ) {
+         if ( qitr != queue.end() ) {
+            queue.erase( qitr );
+         }
+      } else if ( qitr == queue.end() ) {
+         queue.emplace( payer, [&]( auto& q ) {
+            q.owner        = owner;
+            q.request_time = req->request_time;
+         });
+      } else if ( qitr->request_time != req->request_time ) {
+         queue.modify( qitr, same_payer, [&]( auto& q ) {
+            q.request_time = req->request_time;
+         });
+      }
    }
 
 
@@ -17,6 +17,7 @@ namespace eosiosystem {
     _global(get_self(), get_self().value),
     _global2(get_self(), get_self().value),
     _global3(get_self(), get_self().value),
+    _global4(get_self(), get_self().value),
     _rammarket(get_self(), get_self().value),
     _rexpool(get_self(), get_self().value),
     _rexfunds(get_self(), get_self().value),
@@ -24,9 +25,6 @@ namespace eosiosystem {
     _rexorders(get_self(), get_self().value)
    {
       //print( "construct system\n" );
-      _gstate  = _global.exists() ? _global.get() : get_default_parameters();
-      _gstate2 = _global2.exists() ? _global2.get() : eosio_global_state2{};
-      _gstate3 = _global3.exists() ? _global3.get() : eosio_global_state3{};
    }
 
    eosio_global_state system_contract::get_default_parameters() {
@@ -35,25 +33,100 @@ namespace eosiosystem {
       return dp;
    }
 
+   // singletons that do not exist yet are marked dirty when loaded so that they get created on exit
+   const eosio_global_state& system_contract::gstate() {
+      if( !_gstate_loaded ) {
+         _gstate_dirty  = !_global.exists();
+         _gstate        = _gstate_dirty ? get_default_parameters() : _global.get();
+         _gstate_loaded = true;
+      }
+      return _gstate;
+   }
+
+   const eosio_global_state2& system_contract::gstate2() {
+      if( !_gstate2_loaded ) {
+         _gstate2_dirty  = !_global2.exists();
+         _gstate2        = _gstate2_dirty ? eosio_global_state2{} : _global2.get();
+         _gstate2_loaded = true;
+      }
+      return _gstate2;
+   }
+
+   const eosio_global_state3& system_contract::gstate3() {
+      if( !_gstate3_loaded ) {
+         _gstate3_dirty  = !_global3.exists();
+         _gstate3        = _gstate3_dirty ? eosio_global_state3{} : _global3.get();
+         _gstate3_loaded = true;
+      }
+      return _gstate3;
+   }
+
+   const eosio_global_state4& system_contract::gstate4() {
+      if( !_gstate4_loaded ) {
+         _gstate4_dirty  = !_global4.exists();
+         _gstate4        = _gstate4_dirty ? eosio_global_state4{} : _global4.get();
+         _gstate4_loaded = true;
+      }
+      return _gstate4;
+   }
+
+   eosio_global_state& system_contract::mutable_gstate() {
+      gstate();
+      _gstate_dirty = true;
+      return _gstate;
+   }
+
+   eosio_global_state2& system_contract::mutable_gstate2() {
+      gstate2();
+      _gstate2_dirty = true;
+      return _gstate2;
+   }
+
+   eosio_global_state3& system_contract::mutable_gstate3() {
+      gstate3();
+      _gstate3_dirty = true;
+      return _gstate3;
+   }
+
+   eosio_global_state4& system_contract::mutable_gstate4() {
+      gstate4();
+      _gstate4_dirty = true;
+      return _gstate4;
+   }
+
+   bool system_contract::feature_enabled( system_feature feature ) {
+      return (gstate4().features & feature) != 0;
+   }
+
    symbol system_contract::core_symbol()const {
       const static auto sym = get_core_symbol( _rammarket );
       return sym;
    }
 
    system_contract::~system_contract() {
-      _global.set( _gstate, get_self() );
-      _global2.set( _gstate2, get_self() );
-      _global3.set( _gstate3, get_self() );
+      _voters.flush();
+      _producers.flush();
+      _producers2.flush();
+      _rexbalance.flush();
+
+      if( _gstate_dirty )
+         _global.set( _gstate, get_self() );
+      if( _gstate2_dirty )
+         _global2.set( _gstate2, get_self() );
+      if( _gstate3_dirty )
+         _global3.set( _gstate3, get_self() );
+      if( _gstate4_dirty )
+         _global4.set( _gstate4, get_self() );
    }
 
    void system_contract::setram( uint64_t max_ram_size ) {
       require_auth( get_self() );
 
-      check( _gstate.max_ram_size < max_ram_size, "ram may only be increased" ); /// decreasing ram might result market maker issues
+      check( gstate().max_ram_size < max_ram_size, "ram may only be increased" ); /// decreasing ram might result market maker issues
       check( max_ram_size < 1024ll*1024*1024*1024*1024, "ram size is unrealistic" );
-      check( max_ram_size > _gstate.total_ram_bytes_reserved, "attempt to set max below reserved" );
+      check( max_ram_size > gstate().total_ram_bytes_reserved, "attempt to set max below reserved" );
 
-      auto delta = int64_t(max_ram_size) - int64_t(_gstate.max_ram_size);
+      auto delta = int64_t(max_ram_size) - int64_t(gstate().max_ram_size);
       auto itr = _rammarket.find(ramcore_symbol.raw());
 
       /**
@@ -63,17 +136,17 @@ namespace eosiosystem {
          m.base.balance.amount += delta;
       });
 
-      _gstate.max_ram_size = max_ram_size;
+      mutable_gstate().max_ram_size = max_ram_size;
    }
 
    void system_contract::update_ram_supply() {
       auto cbt = eosio::current_block_time();
 
-      if( cbt <= _gstate2.last_ram_increase ) return;
+      if( cbt <= gstate2().last_ram_increase ) return;
 
       auto itr = _rammarket.find(ramcore_symbol.raw());
-      auto new_ram = (cbt.slot - _gstate2.last_ram_increase.slot)*_gstate2.new_ram_per_block;
-      _gstate.max_ram_size += new_ram;
+      auto new_ram = (cbt.slot - gstate2().last_ram_increase.slot)*gstate2().new_ram_per_block;
+      mutable_gstate().max_ram_size += new_ram;
 
       /**
        *  Increase the amount of ram for sale based upon the change in max ram size.
@@ -81,20 +154,32 @@ namespace eosiosystem {
       _rammarket.modify( itr, same_payer, [&]( auto& m ) {
          m.base.balance.amount += new_ram;
       });
-      _gstate2.last_ram_increase = cbt;
+      mutable_gstate2().last_ram_increase = cbt;
+   }
+
+   /**
+    * Ram market as it would be after update_ram_supply, without writing it
+    */
+   exchange_state system_contract::get_ram_market() {
+      auto market = _rammarket.get(ramcore_symbol.raw(), "ram market does not exist");
+      auto cbt = eosio::current_block_time();
+      if( cbt > gstate2().last_ram_increase ) {
+         market.base.balance.amount += (cbt.slot - gstate2().last_ram_increase.slot)*gstate2().new_ram_per_block;
+      }
+      return market;
    }
 
    void system_contract::setramrate( uint16_t bytes_per_block ) {
       require_auth( get_self() );
 
       update_ram_supply();
-      _gstate2.new_ram_per_block = bytes_per_block;
+      mutable_gstate2().new_ram_per_block = bytes_per_block;
    }
 
    void system_contract::setparams( const eosio::blockchain_parameters& params ) {
       require_auth( get_self() );
-      (eosio::blockchain_parameters&)(_gstate) = params;
-      check( 3 <= _gstate.max_authority_depth, "max_authority_depth should be at least 3" );
+      (eosio::blockchain_parameters&)(mutable_gstate()) = params;
+      check( 3 <= gstate().max_authority_depth, "max_authority_depth should be at least 3" );
       set_blockchain_parameters( params );
    }
 
@@ -111,7 +196,7 @@ namespace eosiosystem {
       check( ritr == userres.end(), "only supports unlimited accounts" );
 
       auto vitr = _voters.find( account.value );
-      if( vitr != _voters.end() ) {
+      if( vitr != nullptr ) {
          bool ram_managed = has_field( vitr->flags1, voter_info::flags1_fields::ram_managed );
          bool net_managed = has_field( vitr->flags1, voter_info::flags1_fields::net_managed );
          bool cpu_managed = has_field( vitr->flags1, voter_info::flags1_fields::cpu_managed );
@@ -131,7 +216,7 @@ namespace eosiosystem {
 
       if( !ram_bytes ) {
          auto vitr = _voters.find( account.value );
-         check( vitr != _voters.end() && has_field( vitr->flags1, voter_info::flags1_fields::ram_managed ),
+         check( vitr != nullptr && has_field( vitr->flags1, voter_info::flags1_fields::ram_managed ),
                 "RAM of account is already unmanaged" );
 
          user_resources_table userres( get_self(), account.value );
@@ -142,15 +227,15 @@ namespace eosiosystem {
             ram += ritr->ram_bytes;
          }
 
-         _voters.modify( vitr, same_payer, [&]( auto& v ) {
+         _voters.modify( *vitr, same_payer, [&]( auto& v ) {
             v.flags1 = set_field( v.flags1, voter_info::flags1_fields::ram_managed, false );
          });
       } else {
          check( *ram_bytes >= 0, "not allowed to set RAM limit to unlimited" );
 
          auto vitr = _voters.find( account.value );
-         if ( vitr != _voters.end() ) {
-            _voters.modify( vitr, same_payer, [&]( auto& v ) {
+         if ( vitr != nullptr ) {
+            _voters.modify( *vitr, same_payer, [&]( auto& v ) {
                v.flags1 = set_field( v.flags1, voter_info::flags1_fields::ram_managed, true );
             });
          } else {
@@ -176,7 +261,7 @@ namespace eosiosystem {
 
       if( !net_weight ) {
          auto vitr = _voters.find( account.value );
-         check( vitr != _voters.end() && has_field( vitr->flags1, voter_info::flags1_fields::net_managed ),
+         check( vitr != nullptr && has_field( vitr->flags1, voter_info::flags1_fields::net_managed ),
                 "Network bandwidth of account is already unmanaged" );
 
          user_resources_table userres( get_self(), account.value );
@@ -186,15 +271,15 @@ namespace eosiosystem {
             net = ritr->net_weight.amount;
          }
 
-         _voters.modify( vitr, same_payer, [&]( auto& v ) {
+         _voters.modify( *vitr, same_payer, [&]( auto& v ) {
             v.flags1 = set_field( v.flags1, voter_info::flags1_fields::net_managed, false );
          });
       } else {
          check( *net_weight >= -1, "invalid value for net_weight" );
 
          auto vitr = _voters.find( account.value );
-         if ( vitr != _voters.end() ) {
-            _voters.modify( vitr, same_payer, [&]( auto& v ) {
+         if ( vitr != nullptr ) {
+            _voters.modify( *vitr, same_payer, [&]( auto& v ) {
                v.flags1 = set_field( v.flags1, voter_info::flags1_fields::net_managed, true );
             });
          } else {
@@ -220,7 +305,7 @@ namespace eosiosystem {
 
       if( !cpu_weight ) {
          auto vitr = _voters.find( account.value );
-         check( vitr != _voters.end() && has_field( vitr->flags1, voter_info::flags1_fields::cpu_managed ),
+         check( vitr != nullptr && has_field( vitr->flags1, voter_info::flags1_fields::cpu_managed ),
                 "CPU bandwidth of account is already unmanaged" );
 
          user_resources_table userres( get_self(), account.value );
@@ -230,15 +315,15 @@ namespace eosiosystem {
             cpu = ritr->cpu_weight.amount;
          }
 
-         _voters.modify( vitr, same_payer, [&]( auto& v ) {
+         _voters.modify( *vitr, same_payer, [&]( auto& v ) {
             v.flags1 = set_field( v.flags1, voter_info::flags1_fields::cpu_managed, false );
          });
       } else {
          check( *cpu_weight >= -1, "invalid value for cpu_weight" );
 
          auto vitr = _voters.find( account.value );
-         if ( vitr != _voters.end() ) {
-            _voters.modify( vitr, same_payer, [&]( auto& v ) {
+         if ( vitr != nullptr ) {
+            _voters.modify( *vitr, same_payer, [&]( auto& v ) {
                v.flags1 = set_field( v.flags1, voter_info::flags1_fields::cpu_managed, true );
             });
          } else {
@@ -262,19 +347,36 @@ namespace eosiosystem {
    void system_contract::rmvproducer( const name& producer ) {
       require_auth( get_self() );
       auto prod = _producers.find( producer.value );
-      check( prod != _producers.end(), "producer not found" );
-      _producers.modify( prod, same_payer, [&](auto& p) {
+      check( prod != nullptr, "producer not found" );
+      _producers.modify( *prod, same_payer, [&](auto& p) {
             p.deactivate();
          });
    }
 
    void system_contract::updtrevision( uint8_t revision ) {
       require_auth( get_self() );
-      check( _gstate2.revision < 255, "can not increment revision" ); // prevent wrap around
-      check( revision == _gstate2.revision + 1, "can only increment revision by one" );
+      check( gstate2().revision < 255, "can not increment revision" ); // prevent wrap around
+      check( revision == gstate2().revision + 1, "can only increment revision by one" );
       check( revision <= 1, // set upper bound to greatest revision supported in the code
                     "specified revision is not yet supported by the code" );
-      _gstate2.revision = revision;
+      mutable_gstate2().revision = revision;
+   }
+
+   void system_contract::setfeature( const name& feature, bool enabled ) {
+      require_auth( get_self() );
+      uint64_t flag = 0;
+      if( feature == "perinflation"_n ) {
+         flag = feature_periodic_inflation;
+      } else if( feature == "lazyrefunds"_n ) {
+         flag = feature_lazy_refunds;
+      } else if( feature == "lazybidrefnd"_n ) {
+         flag = feature_lazy_bid_refunds;
+      } else if( feature == "partialfills"_n ) {
+         flag = feature_partial_rex_fills;
+      }
+      check( flag != 0, "unknown feature" );
+      auto& gs4 = mutable_gstate4();
+      gs4.features = enabled ? (gs4.features | flag) : (gs4.features & ~flag);
    }
 
 
@@ -356,12 +458,17 @@ namespace eosiosystem {
       _rammarket.emplace( get_self(), [&]( auto& m ) {
          m.supply.amount = 100000000000000ll;
          m.supply.symbol = ramcore_symbol;
-         m.base.balance.amount = int64_t(_gstate.free_ram());
+         m.base.balance.amount = int64_t(gstate().free_ram());
          m.base.balance.symbol = ram_symbol;
          m.quote.balance.amount = system_token_supply.amount / 1000;
          m.quote.balance.symbol = core;
       });
 
+      // global state singletons are otherwise only created by the first action writing to them
+      mutable_gstate();
+      mutable_gstate2();
+      mutable_gstate3();
+
       token::open_action open_act{ token_account, { {get_self(), active_permission} } };
       open_act.send( rex_account, core, get_self() );
    }
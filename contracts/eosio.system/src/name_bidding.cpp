@@ -18,8 +18,20 @@ namespace eosiosystem {
       check( !is_account( newname ), "account already exists" );
       check( bid.symbol == core_symbol(), "asset must be system token" );
       check( bid.amount > 0, "insufficient bid" );
-      token::transfer_action transfer_act{ token_account, { {bidder, active_permission} } };
-      transfer_act.send( bidder, names_account, bid, std::string("bid name ")+ newname.to_string() );
+
+      const bool lazy_refunds = feature_enabled( feature_lazy_bid_refunds );
+      asset payment = bid;
+      if ( lazy_refunds ) {
+         // pending refunds of the bidder are netted against the new bid
+         payment -= take_bid_refunds( bidder );
+      }
+      if ( payment.amount > 0 ) {
+         token::transfer_action transfer_act{ token_account, { {bidder, active_permission} } };
+         transfer_act.send( bidder, names_account, payment, std::string("bid name ")+ newname.to_string() );
+      } else if ( payment.amount < 0 ) {
+         token::transfer_action transfer_act{ token_account, { {names_account, active_permission} } };
+         transfer_act.send( names_account, bidder, -payment, std::string("refund bids net of bid on name ")+ newname.to_string() );
+      }
       name_bid_table bids(get_self(), get_self().value);
       print( name{bidder}, " bid ", bid, " on ", name{newname}, "\n" );
       auto current = bids.find( newname.value );
@@ -49,15 +61,19 @@ namespace eosiosystem {
                });
          }
 
-         eosio::transaction t;
-         t.actions.emplace_back( permission_level{get_self(), active_permission},
-                                 get_self(), "bidrefund"_n,
-                                 std::make_tuple( current->high_bidder, newname )
-         );
-         t.delay_sec = 0;
-         uint128_t deferred_id = (uint128_t(newname.value) << 64) | current->high_bidder.value;
-         eosio::cancel_deferred( deferred_id );
-         t.send( deferred_id, bidder );
+         if ( lazy_refunds ) {
+            queue_bid_refund( current->high_bidder, newname, bidder );
+         } else {
+            eosio::transaction t;
+            t.actions.emplace_back( permission_level{get_self(), active_permission},
+                                    get_self(), "bidrefund"_n,
+                                    std::make_tuple( current->high_bidder, newname )
+            );
+            t.delay_sec = 0;
+            uint128_t deferred_id = (uint128_t(newname.value) << 64) | current->high_bidder.value;
+            eosio::cancel_deferred( deferred_id );
+            t.send( deferred_id, bidder );
+         }
 
          bids.modify( current, bidder, [&]( auto& b ) {
             b.high_bidder = bidder;
@@ -65,6 +81,14 @@ namespace eosiosystem {
             b.last_bid_time = current_time_point();
          });
       }
+
+      // bids only increase, so the new bid either becomes the top open bid or leaves it unchanged
+      top_name_bid_singleton top_sing( get_self(), get_self().value );
+      const auto top = get_top_name_bid( top_sing );
+      if ( top.newname == newname || bid.amount > top.high_bid ||
+           (bid.amount == top.high_bid && newname.value < top.newname.value) ) {
+         top_sing.set( top_name_bid{ newname, bid.amount, current_time_point() }, get_self() );
+      }
    }
 
    void system_contract::bidrefund( const name& bidder, const name& newname ) {
@@ -75,6 +99,106 @@ namespace eosiosystem {
       token::transfer_action transfer_act{ token_account, { {names_account, active_permission}, {bidder, active_permission} } };
       transfer_act.send( names_account, bidder, asset(it->amount), std::string("refund bid on name ")+(name{newname}).to_string() );
       refunds_table.erase( it );
+
+      bid_refund_queue_table queue( get_self(), get_self().value );
+      auto idx = queue.get_index<"bybidder"_n>();
+      auto qitr = idx.find( (uint128_t(bidder.value) << 64) | newname.value );
+      if ( qitr != idx.end() ) {
+         idx.erase( qitr );
+      }
+   }
+
+   void system_contract::settlebids( const name& user, uint16_t max ) {
+      require_auth( user );
+      check( feature_enabled( feature_lazy_bid_refunds ), "bid refunds are paid by deferred transactions unless lazy bid refunds are enabled" );
+
+      bid_refund_queue_table queue( get_self(), get_self().value );
+      for ( uint16_t i = 0; i < max; ++i ) {
+         auto itr = queue.begin();
+         if ( itr == queue.end() ) break;
+
+         const name bidder  = itr->bidder;
+         const name newname = itr->newname;
+         queue.erase( itr );
+
+         const asset amount = take_bid_refund( bidder, newname );
+         if ( amount.amount > 0 ) {
+            token::transfer_action transfer_act{ token_account, { {names_account, active_permission} } };
+            transfer_act.send( names_account, bidder, amount, std::string("refund bid on name ")+ newname.to_string() );
+         }
+      }
+   }
+
+   /**
+    * Removes the refund of `bidder` for `newname`, the queue entry is left to the caller. A refund outbid
+    * before lazy bid refunds were enabled may still have a deferred `bidrefund` pending, which is canceled.
+    *
+    * @return the amount of the removed refund, zero if there was none
+    */
+   asset system_contract::take_bid_refund( const name& bidder, const name& newname ) {
+      asset amount( 0, core_symbol() );
+      bid_refund_table refunds_table( get_self(), newname.value );
+      auto it = refunds_table.find( bidder.value );
+      if ( it != refunds_table.end() ) {
+         amount = it->amount;
+         refunds_table.erase( it );
+      }
+      eosio::cancel_deferred( (uint128_t(newname.value) << 64) | bidder.value );
+      return amount;
+   }
+
+   /**
+    * Removes all queued refunds of `bidder` together with their queue entries
+    *
+    * @return the total amount of the removed refunds
+    */
+   asset system_contract::take_bid_refunds( const name& bidder ) {
+      asset total( 0, core_symbol() );
+      bid_refund_queue_table queue( get_self(), get_self().value );
+      auto idx = queue.get_index<"bybidder"_n>();
+      auto itr = idx.lower_bound( uint128_t(bidder.value) << 64 );
+      while ( itr != idx.end() && itr->bidder == bidder ) {
+         total += take_bid_refund( bidder, itr->newname );
+         itr = idx.erase( itr );
+      }
+      return total;
+   }
+
+   /**
+    * Queues the refund of `bidder` for `newname` unless it is already queued
+    */
+   void system_contract::queue_bid_refund( const name& bidder, const name& newname, const name& payer ) {
+      bid_refund_queue_table queue( get_self(), get_self().value );
+      auto idx = queue.get_index<"bybidder"_n>();
+      if ( idx.find( (uint128_t(bidder.value) << 64) | newname.value ) != idx.end() ) return;
+
+      const uint64_t id = queue.available_primary_key();
+      queue.emplace( payer, [&]( auto& q ) {
+         q.id      = id;
+         q.bidder  = bidder;
+         q.newname = newname;
+      });
+   }
+
+   /**
+    * Reads the top open bid, it is looked up in the `highbid` index once if the singleton does not exist yet
+    */
+   top_name_bid system_contract::get_top_name_bid( top_name_bid_singleton& top_sing ) {
+      if ( top_sing.exists() )
+         return top_sing.get();
+
+      name_bid_table bids(get_self(), get_self().value);
+      const auto top = find_top_name_bid( bids );
+      top_sing.set( top, get_self() );
+      return top;
+   }
+
+   top_name_bid system_contract::find_top_name_bid( name_bid_table& bids ) {
+      auto idx = bids.get_index<"highbid"_n>();
+      auto highest = idx.lower_bound( std::numeric_limits<uint64_t>::max()/2 );
+      if ( highest == idx.end() || highest->high_bid <= 0 )
+         return top_name_bid{};
+      return top_name_bid{ highest->newname, highest->high_bid, highest->last_bid_time };
    }
 
 }
@@ -19,69 +19,85 @@ namespace eosiosystem {
       // _gstate2.last_block_num is not used anywhere in the system contract code anymore.
       // Although this field is deprecated, we will continue updating it for now until the last_block_num field
       // is eventually completely removed, at which point this line can be removed.
-      _gstate2.last_block_num = timestamp;
+      mutable_gstate2().last_block_num = timestamp;
 
       /** until activated stake crosses this threshold no new rewards are paid */
-      if( _gstate.total_activated_stake < min_activated_stake )
+      if( gstate().total_activated_stake < min_activated_stake )
          return;
 
-      if( _gstate.last_pervote_bucket_fill == time_point() )  /// start the presses
-         _gstate.last_pervote_bucket_fill = current_time_point();
+      if( gstate().last_pervote_bucket_fill == time_point() )  /// start the presses
+         mutable_gstate().last_pervote_bucket_fill = current_time_point();
 
 
       /**
-       * At startup the initial producer may not be one that is registered / elected
-       * and therefore there may be no producer object for them.
+       * Blocks are counted in the small unpaidblocks row of the producer and only added to the producers
+       * table and the global state by flush_unpaid_blocks, so that neither is rewritten on every block.
        */
-      auto prod = _producers.find( producer.value );
-      if ( prod != _producers.end() ) {
-         _gstate.total_unpaid_blocks++;
-         _producers.modify( prod, same_payer, [&](auto& p ) {
-               p.unpaid_blocks++;
+      unpaid_blocks_table unpaid( get_self(), get_self().value );
+      auto entry = unpaid.find( producer.value );
+      if( entry != unpaid.end() ) {
+         unpaid.modify( entry, same_payer, [&]( auto& u ) {
+            u.blocks++;
+         });
+      } else {
+         unpaid.emplace( get_self(), [&]( auto& u ) {
+            u.producer = producer;
+            u.blocks   = 1;
          });
       }
 
       /// only update block producers once every minute, block_timestamp is in half seconds
-      if( timestamp.slot - _gstate.last_producer_schedule_update.slot > 120 ) {
+      if( timestamp.slot - gstate().last_producer_schedule_update.slot > 120 ) {
+         flush_unpaid_blocks( unpaid );
          update_elected_producers( timestamp );
 
-         if( (timestamp.slot - _gstate.last_name_close.slot) > blocks_per_day ) {
-            name_bid_table bids(get_self(), get_self().value);
-            auto idx = bids.get_index<"highbid"_n>();
-            auto highest = idx.lower_bound( std::numeric_limits<uint64_t>::max()/2 );
-            if( highest != idx.end() &&
-                highest->high_bid > 0 &&
-                (current_time_point() - highest->last_bid_time) > microseconds(useconds_per_day) &&
-                _gstate.thresh_activated_stake_time > time_point() &&
-                (current_time_point() - _gstate.thresh_activated_stake_time) > microseconds(14 * useconds_per_day)
+         if( feature_enabled( feature_periodic_inflation ) ) {
+            const auto ct = current_time_point();
+            if( ct - gstate().last_pervote_bucket_fill >= microseconds(useconds_per_fill) )
+               fill_inflation_buckets( ct );
+         }
+
+         if( (timestamp.slot - gstate().last_name_close.slot) > blocks_per_day ) {
+            top_name_bid_singleton top_sing(get_self(), get_self().value);
+            const auto highest = get_top_name_bid( top_sing );
+            if( highest.high_bid > 0 &&
+                (current_time_point() - highest.last_bid_time) > microseconds(useconds_per_day) &&
+                gstate().thresh_activated_stake_time > time_point() &&
+                (current_time_point() - gstate().thresh_activated_stake_time) > microseconds(14 * useconds_per_day)
             ) {
-               _gstate.last_name_close = timestamp;
-               channel_namebid_to_rex( highest->high_bid );
-               idx.modify( highest, same_payer, [&]( auto& b ){
+               mutable_gstate().last_name_close = timestamp;
+               channel_namebid_to_rex( highest.high_bid );
+               name_bid_table bids(get_self(), get_self().value);
+               bids.modify( bids.get( highest.newname.value ), same_payer, [&]( auto& b ){
                   b.high_bid = -b.high_bid;
                });
+               top_sing.set( find_top_name_bid( bids ), get_self() );
             }
          }
       }
    }
 
-   void system_contract::claimrewards( const name& owner ) {
-      require_auth( owner );
-
-      const auto& prod = _producers.get( owner.value );
-      check( prod.active(), "producer does not have an active key" );
-
-      check( _gstate.total_activated_stake >= min_activated_stake,
-                    "cannot claim rewards until the chain is activated (at least 15% of all tokens participate in voting)" );
-
-      const auto ct = current_time_point();
-
-      check( ct - prod.last_claim_time > microseconds(useconds_per_day), "already claimed rewards within past day" );
+   void system_contract::flush_unpaid_blocks( unpaid_blocks_table& unpaid ) {
+      /**
+       * At startup the initial producer may not be one that is registered / elected
+       * and therefore there may be no producer object for them.
+       */
+      for( auto it = unpaid.begin(); it != unpaid.end(); it = unpaid.erase( it ) ) {
+         auto prod = _producers.find( it->producer.value );
+         if( prod != nullptr ) {
+            mutable_gstate().total_unpaid_blocks += it->blocks;
+            _producers.modify( *prod, same_payer, [&](auto& p ) {
+                  p.unpaid_blocks += it->blocks;
+            });
+         }
+      }
+   }
 
-      const asset token_supply   = token::get_supply(token_account, core_symbol().code() );
-      const auto usecs_since_last_fill = (ct - _gstate.last_pervote_bucket_fill).count();
+   void system_contract::fill_inflation_buckets( const time_point& ct ) {
+      const auto usecs_since_last_fill = (ct - gstate().last_pervote_bucket_fill).count();
 
-      if( usecs_since_last_fill > 0 && _gstate.last_pervote_bucket_fill > time_point() ) {
+      if( usecs_since_last_fill > 0 && gstate().last_pervote_bucket_fill > time_point() ) {
+         const asset token_supply = token::get_supply(token_account, core_symbol().code() );
          auto new_tokens = static_cast<int64_t>( (continuous_rate * double(token_supply.amount) * double(usecs_since_last_fill)) / double(useconds_per_year) );
 
          auto to_producers     = new_tokens / inflation_pay_factor;
@@ -99,10 +115,44 @@ namespace eosiosystem {
             transfer_act.send( get_self(), vpay_account, asset(to_per_vote_pay, core_symbol()), "fund per-vote bucket" );
          }
 
-         _gstate.pervote_bucket          += to_per_vote_pay;
-         _gstate.perblock_bucket         += to_per_block_pay;
-         _gstate.last_pervote_bucket_fill = ct;
+         auto& gs = mutable_gstate();
+         gs.pervote_bucket          += to_per_vote_pay;
+         gs.perblock_bucket         += to_per_block_pay;
+         gs.last_pervote_bucket_fill = ct;
       }
+   }
+
+   void system_contract::fillbuckets( const name& user ) {
+      require_auth( user );
+
+      check( feature_enabled( feature_periodic_inflation ), "buckets are filled by claimrewards unless periodic inflation is enabled" );
+      check( gstate().total_activated_stake >= min_activated_stake,
+                    "cannot fill buckets until the chain is activated (at least 15% of all tokens participate in voting)" );
+
+      const auto ct = current_time_point();
+      if( ct - gstate().last_pervote_bucket_fill >= microseconds(useconds_per_fill) )
+         fill_inflation_buckets( ct );
+   }
+
+   void system_contract::claimrewards( const name& owner ) {
+      require_auth( owner );
+
+      unpaid_blocks_table unpaid( get_self(), get_self().value );
+      flush_unpaid_blocks( unpaid );
+
+      const auto& prod = _producers.get( owner.value );
+      check( prod.active(), "producer does not have an active key" );
+
+      check( gstate().total_activated_stake >= min_activated_stake,
+                    "cannot claim rewards until the chain is activated (at least 15% of all tokens participate in voting)" );
+
+      const auto ct = current_time_point();
+
+      check( ct - prod.last_claim_time > microseconds(useconds_per_day), "already claimed rewards within past day" );
+
+      /// with periodic inflation the buckets are filled by onblock and fillbuckets
+      if( !feature_enabled( feature_periodic_inflation ) )
+         fill_inflation_buckets( ct );
 
       auto prod2 = _producers2.find( owner.value );
 
@@ -112,10 +162,10 @@ namespace eosiosystem {
 
       bool crossed_threshold       = (last_claim_plus_3days <= ct);
       bool updated_after_threshold = true;
-      if ( prod2 != _producers2.end() ) {
+      if ( prod2 != nullptr ) {
          updated_after_threshold = (last_claim_plus_3days <= prod2->last_votepay_share_update);
       } else {
-         prod2 = _producers2.emplace( owner, [&]( producer_info2& info  ) {
+         prod2 = &_producers2.emplace( owner, [&]( producer_info2& info  ) {
             info.owner                     = owner;
             info.last_votepay_share_update = ct;
          });
@@ -127,27 +177,27 @@ namespace eosiosystem {
       // In fact it is desired behavior because the producers votes need to be counted in the global total_producer_votepay_share for the first time.
 
       int64_t producer_per_block_pay = 0;
-      if( _gstate.total_unpaid_blocks > 0 ) {
-         producer_per_block_pay = (_gstate.perblock_bucket * prod.unpaid_blocks) / _gstate.total_unpaid_blocks;
+      if( gstate().total_unpaid_blocks > 0 ) {
+         producer_per_block_pay = (gstate().perblock_bucket * prod.unpaid_blocks) / gstate().total_unpaid_blocks;
       }
 
-      double new_votepay_share = update_producer_votepay_share( prod2,
+      double new_votepay_share = update_producer_votepay_share( *prod2,
                                     ct,
                                     updated_after_threshold ? 0.0 : prod.total_votes,
                                     true // reset votepay_share to zero after updating
                                  );
 
       int64_t producer_per_vote_pay = 0;
-      if( _gstate2.revision > 0 ) {
+      if( gstate2().revision > 0 ) {
          double total_votepay_share = update_total_votepay_share( ct );
          if( total_votepay_share > 0 && !crossed_threshold ) {
-            producer_per_vote_pay = int64_t((new_votepay_share * _gstate.pervote_bucket) / total_votepay_share);
-            if( producer_per_vote_pay > _gstate.pervote_bucket )
-               producer_per_vote_pay = _gstate.pervote_bucket;
+            producer_per_vote_pay = int64_t((new_votepay_share * gstate().pervote_bucket) / total_votepay_share);
+            if( producer_per_vote_pay > gstate().pervote_bucket )
+               producer_per_vote_pay = gstate().pervote_bucket;
          }
       } else {
-         if( _gstate.total_producer_vote_weight > 0 ) {
-            producer_per_vote_pay = int64_t((_gstate.pervote_bucket * prod.total_votes) / _gstate.total_producer_vote_weight);
+         if( gstate().total_producer_vote_weight > 0 ) {
+            producer_per_vote_pay = int64_t((gstate().pervote_bucket * prod.total_votes) / gstate().total_producer_vote_weight);
          }
       }
 
@@ -155,9 +205,10 @@ namespace eosiosystem {
          producer_per_vote_pay = 0;
       }
 
-      _gstate.pervote_bucket      -= producer_per_vote_pay;
-      _gstate.perblock_bucket     -= producer_per_block_pay;
-      _gstate.total_unpaid_blocks -= prod.unpaid_blocks;
+      auto& gs = mutable_gstate();
+      gs.pervote_bucket      -= producer_per_vote_pay;
+      gs.perblock_bucket     -= producer_per_block_pay;
+      gs.total_unpaid_blocks -= prod.unpaid_blocks;
 
       update_total_votepay_share( ct, -new_votepay_share, (updated_after_threshold ? prod.total_votes : 0.0) );
 
@@ -2,6 +2,9 @@
 #include <eosio.token/eosio.token.hpp>
 #include <eosio.system/rex.results.hpp>
 
+#include <algorithm>
+#include <map>
+
 namespace eosiosystem {
 
    using eosio::current_time_point;
@@ -46,7 +49,7 @@ namespace eosiosystem {
       transfer_from_fund( from, amount );
       const asset rex_received    = add_to_rex_pool( amount );
       const asset delta_rex_stake = add_to_rex_balance( from, amount, rex_received );
-      runrex(2);
+      runrex( rex_action_budget() );
       update_rex_account( from, asset( 0, core_symbol() ), delta_rex_stake );
       // dummy action added so that amount of REX tokens purchased shows up in action trace
       rex_results::buyresult_action buyrex_act( rex_account, std::vector<eosio::permission_level>{ } );
@@ -86,7 +89,7 @@ namespace eosiosystem {
       }
       const asset rex_received = add_to_rex_pool( payment );
       add_to_rex_balance( owner, payment, rex_received );
-      runrex(2);
+      runrex( rex_action_budget() );
       update_rex_account( owner, asset( 0, core_symbol() ), asset( 0, core_symbol() ), true );
       // dummy action added so that amount of REX tokens purchased shows up in action trace
       rex_results::buyresult_action buyrex_act( rex_account, std::vector<eosio::permission_level>{ } );
@@ -97,15 +100,15 @@ namespace eosiosystem {
    {
       require_auth( from );
 
-      runrex(2);
+      runrex( rex_action_budget() );
 
       auto bitr = _rexbalance.require_find( from.value, "user must first buyrex" );
       check( rex.amount > 0 && rex.symbol == bitr->rex_balance.symbol,
              "asset must be a positive amount of (REX, 4)" );
-      process_rex_maturities( bitr );
+      process_rex_maturities( *bitr );
       check( rex.amount <= bitr->matured_rex, "insufficient available rex" );
 
-      const auto current_order = fill_rex_order( bitr, rex );
+      const auto current_order = fill_rex_order( *bitr, rex );
       if ( current_order.success && current_order.proceeds.amount == 0 ) {
          check( false, "proceeds are negligible" );
       }
@@ -149,7 +152,14 @@ namespace eosiosystem {
 
       auto itr = _rexorders.require_find( owner.value, "no sellrex order is scheduled" );
       check( itr->is_open, "sellrex order has been filled and cannot be canceled" );
+      // an open order carries the proceeds of its partial fills, which are not canceled
+      const asset proceeds     = itr->proceeds;
+      const asset stake_change = itr->stake_change;
       _rexorders.erase( itr );
+      if ( proceeds.amount > 0 )
+         transfer_to_fund( owner, proceeds );
+      if ( stake_change.amount != 0 )
+         update_voting_power( owner, stake_change );
    }
 
    void system_contract::rentcpu( const name& from, const name& receiver, const asset& loan_payment, const asset& loan_fund )
@@ -206,7 +216,7 @@ namespace eosiosystem {
    {
       require_auth( owner );
 
-      runrex(2);
+      runrex( rex_action_budget() );
 
       auto itr = _rexbalance.require_find( owner.value, "account has no REX balance" );
       const asset init_stake = itr->vote_stake;
@@ -220,12 +230,12 @@ namespace eosiosystem {
       if ( total_rex > 0 ) {
          current_stake.amount = ( uint128_t(rex_balance) * total_lendable ) / total_rex;
       }
-      _rexbalance.modify( itr, same_payer, [&]( auto& rb ) {
+      _rexbalance.modify( *itr, same_payer, [&]( auto& rb ) {
          rb.vote_stake = current_stake;
       });
 
       update_rex_account( owner, asset( 0, core_symbol() ), current_stake - init_stake, true );
-      process_rex_maturities( itr );
+      process_rex_maturities( *itr );
    }
 
    void system_contract::setrex( const asset& balance )
@@ -240,6 +250,16 @@ namespace eosiosystem {
       });
    }
 
+   void system_contract::setrexmaint( uint16_t action_budget )
+   {
+      require_auth( get_self() );
+
+      rex_maintenance_singleton rexmaint( get_self(), get_self().value );
+      auto maint = rexmaint.get_or_default();
+      maint.action_budget = action_budget;
+      rexmaint.set( maint, get_self() );
+   }
+
    void system_contract::rexexec( const name& user, uint16_t max )
    {
       require_auth( user );
@@ -247,31 +267,58 @@ namespace eosiosystem {
       runrex( max );
    }
 
+   void system_contract::quoterent( const asset& loan_payment )
+   {
+      check( rex_loans_available(), "rex loans are currently not available" );
+      check( loan_payment.symbol == core_symbol(), "must use core token" );
+      check( 0 < loan_payment.amount, "must use positive asset amount" );
+
+      const auto& pool = _rexpool.begin(); /// already checked that _rexpool.begin() != _rexpool.end() in rex_loans_available()
+      const int64_t rented_tokens = exchange_state::get_bancor_output( pool->total_rent.amount,
+                                                                       pool->total_unlent.amount,
+                                                                       loan_payment.amount );
+
+      rex_results::quoteresult_action quote_act( rex_account, std::vector<eosio::permission_level>{ } );
+      quote_act.send( asset( rented_tokens, core_symbol() ) );
+   }
+
+   void system_contract::quotesellrex( const asset& rex )
+   {
+      check( rex_available(), "rex system not initialized yet" );
+      check( rex.amount > 0 && rex.symbol == rex_symbol, "asset must be a positive amount of (REX, 4)" );
+
+      const auto& pool = _rexpool.begin();
+      const int64_t proceeds = ( uint128_t(rex.amount) * pool->total_lendable.amount ) / pool->total_rex.amount;
+
+      rex_results::quoteresult_action quote_act( rex_account, std::vector<eosio::permission_level>{ } );
+      quote_act.send( asset( proceeds, core_symbol() ) );
+   }
+
    void system_contract::consolidate( const name& owner )
    {
       require_auth( owner );
 
-      runrex(2);
+      runrex( rex_action_budget() );
 
       auto bitr = _rexbalance.require_find( owner.value, "account has no REX balance" );
       asset rex_in_sell_order = update_rex_account( owner, asset( 0, core_symbol() ), asset( 0, core_symbol() ) );
-      consolidate_rex_balance( bitr, rex_in_sell_order );
+      consolidate_rex_balance( *bitr, rex_in_sell_order );
    }
 
    void system_contract::mvtosavings( const name& owner, const asset& rex )
    {
       require_auth( owner );
 
-      runrex(2);
+      runrex( rex_action_budget() );
 
       auto bitr = _rexbalance.require_find( owner.value, "account has no REX balance" );
       check( rex.amount > 0 && rex.symbol == bitr->rex_balance.symbol, "asset must be a positive amount of (REX, 4)" );
       const asset   rex_in_sell_order = update_rex_account( owner, asset( 0, core_symbol() ), asset( 0, core_symbol() ) );
-      const int64_t rex_in_savings    = read_rex_savings( bitr );
+      const int64_t rex_in_savings    = read_rex_savings( *bitr );
       check( rex.amount + rex_in_sell_order.amount + rex_in_savings <= bitr->rex_balance.amount,
              "insufficient REX balance" );
-      process_rex_maturities( bitr );
-      _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
+      process_rex_maturities( *bitr );
+      _rexbalance.modify( *bitr, same_payer, [&]( auto& rb ) {
          int64_t moved_rex = 0;
          while ( !rb.rex_maturities.empty() && moved_rex < rex.amount) {
             const int64_t drex = std::min( rex.amount - moved_rex, rb.rex_maturities.back().second );
@@ -289,21 +336,21 @@ namespace eosiosystem {
          }
          check( moved_rex == rex.amount, "programmer error in mvtosavings" );
       });
-      put_rex_savings( bitr, rex_in_savings + rex.amount );
+      put_rex_savings( *bitr, rex_in_savings + rex.amount );
    }
 
    void system_contract::mvfrsavings( const name& owner, const asset& rex )
    {
       require_auth( owner );
 
-      runrex(2);
+      runrex( rex_action_budget() );
 
       auto bitr = _rexbalance.require_find( owner.value, "account has no REX balance" );
       check( rex.amount > 0 && rex.symbol == bitr->rex_balance.symbol, "asset must be a positive amount of (REX, 4)" );
-      const int64_t rex_in_savings = read_rex_savings( bitr );
+      const int64_t rex_in_savings = read_rex_savings( *bitr );
       check( rex.amount <= rex_in_savings, "insufficient REX in savings" );
-      process_rex_maturities( bitr );
-      _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
+      process_rex_maturities( *bitr );
+      _rexbalance.modify( *bitr, same_payer, [&]( auto& rb ) {
          const time_point_sec maturity = get_rex_maturity();
          if ( !rb.rex_maturities.empty() && rb.rex_maturities.back().first == maturity ) {
             rb.rex_maturities.back().second += rex.amount;
@@ -311,7 +358,7 @@ namespace eosiosystem {
             rb.rex_maturities.emplace_back( maturity, rex.amount );
          }
       });
-      put_rex_savings( bitr, rex_in_savings - rex.amount );
+      put_rex_savings( *bitr, rex_in_savings - rex.amount );
       update_rex_account( owner, asset( 0, core_symbol() ), asset( 0, core_symbol() ) );
    }
 
@@ -320,7 +367,7 @@ namespace eosiosystem {
       require_auth( owner );
 
       if ( rex_system_initialized() )
-         runrex(2);
+         runrex( rex_action_budget() );
 
       update_rex_account( owner, asset( 0, core_symbol() ), asset( 0, core_symbol() ) );
 
@@ -345,9 +392,9 @@ namespace eosiosystem {
       /// check for remaining rex balance
       {
          auto rex_itr = _rexbalance.find( owner.value );
-         if ( rex_itr != _rexbalance.end() ) {
+         if ( rex_itr != nullptr ) {
             check( rex_itr->rex_balance.amount == 0, "account has remaining REX balance, must sell first");
-            _rexbalance.erase( rex_itr );
+            _rexbalance.erase( *rex_itr );
          }
       }
    }
@@ -389,7 +436,7 @@ namespace eosiosystem {
          bool cpu_managed = false;
 
          auto voter_itr = _voters.find( receiver.value );
-         if( voter_itr != _voters.end() ) {
+         if( voter_itr != nullptr ) {
             net_managed = has_field( voter_itr->flags1, voter_info::flags1_fields::net_managed );
             cpu_managed = has_field( voter_itr->flags1, voter_info::flags1_fields::cpu_managed );
          }
@@ -417,10 +464,10 @@ namespace eosiosystem {
     * @param owner - account buying or already holding REX tokens
     * @err_msg - error message
     */
-   void system_contract::check_voting_requirement( const name& owner, const char* error_msg )const
+   void system_contract::check_voting_requirement( const name& owner, const char* error_msg )
    {
       auto vitr = _voters.find( owner.value );
-      check( vitr != _voters.end() && ( vitr->proxy || 21 <= vitr->producers.size() ), error_msg );
+      check( vitr != nullptr && ( vitr->proxy || 21 <= vitr->producers.size() ), error_msg );
    }
 
    /**
@@ -504,6 +551,15 @@ namespace eosiosystem {
       return delta_stake;
    }
 
+   /**
+    * @brief Number of each of expired NET and CPU loans and sellrex orders processed by a user-facing REX action
+    */
+   uint16_t system_contract::rex_action_budget()const
+   {
+      rex_maintenance_singleton rexmaint( get_self(), get_self().value );
+      return rexmaint.get_or_default().action_budget;
+   }
+
    /**
     * @brief Performs maintenance operations on expired NET and CPU loans and sellrex orders
     *
@@ -545,6 +601,15 @@ namespace eosiosystem {
          return { delete_loan, delta_stake };
       };
 
+      /// stake changes of processed loans, accumulated per (from, receiver) and applied once after both loan passes
+      std::map<std::pair<name, name>, std::pair<int64_t, int64_t>> stake_deltas;
+
+      auto add_stake_delta = [&]( const name& from, const name& receiver, int64_t delta_net, int64_t delta_cpu ) {
+         auto& d = stake_deltas[ std::make_pair( from, receiver ) ];
+         d.first  += delta_net;
+         d.second += delta_cpu;
+      };
+
       /// transfer from eosio.names to eosio.rex
       if ( pool->namebid_proceeds.amount > 0 ) {
          channel_to_rex( names_account, pool->namebid_proceeds );
@@ -563,7 +628,7 @@ namespace eosiosystem {
 
             auto result = process_expired_loan( cpu_idx, itr );
             if ( result.second != 0 )
-               update_resource_limits( itr->from, itr->receiver, 0, result.second );
+               add_stake_delta( itr->from, itr->receiver, 0, result.second );
 
             if ( result.first )
                cpu_idx.erase( itr );
@@ -580,15 +645,20 @@ namespace eosiosystem {
 
             auto result = process_expired_loan( net_idx, itr );
             if ( result.second != 0 )
-               update_resource_limits( itr->from, itr->receiver, result.second, 0 );
+               add_stake_delta( itr->from, itr->receiver, result.second, 0 );
 
             if ( result.first )
                net_idx.erase( itr );
          }
       }
 
-      /// process sellrex orders
+      for ( const auto& d : stake_deltas ) {
+         update_resource_limits( d.first.first, d.first.second, d.second.first, d.second.second );
+      }
+
+      /// process sellrex orders, with partial fills enabled orders that cannot be filled are filled partially
       if ( _rexorders.begin() != _rexorders.end() ) {
+         const bool partial_fills = feature_enabled( feature_partial_rex_fills );
          auto idx  = _rexorders.get_index<"bytime"_n>();
          auto oitr = idx.begin();
          for ( uint16_t i = 0; i < max; ++i ) {
@@ -596,18 +666,29 @@ namespace eosiosystem {
             auto next = oitr;
             ++next;
             auto bitr = _rexbalance.find( oitr->owner.value );
-            if ( bitr != _rexbalance.end() ) { // should always be true
-               auto result = fill_rex_order( bitr, oitr->rex_requested );
+            if ( bitr != nullptr ) { // should always be true
+               auto result = fill_rex_order( *bitr, oitr->rex_requested );
                if ( result.success ) {
-                  const name order_owner = oitr->owner;
+                  const name  order_owner    = oitr->owner;
+                  const asset order_proceeds = oitr->proceeds + result.proceeds;
                   idx.modify( oitr, same_payer, [&]( auto& order ) {
-                     order.proceeds.amount     = result.proceeds.amount;
-                     order.stake_change.amount = result.stake_change.amount;
+                     order.proceeds.amount     += result.proceeds.amount;
+                     order.stake_change.amount += result.stake_change.amount;
                      order.close();
                   });
                   /// send dummy action to show owner and proceeds of filled sellrex order
                   rex_results::orderresult_action order_act( rex_account, std::vector<eosio::permission_level>{ } );
-                  order_act.send( order_owner, result.proceeds );
+                  order_act.send( order_owner, order_proceeds );
+               } else if ( partial_fills ) {
+                  const asset fillable = get_fillable_rex( oitr->rex_requested );
+                  if ( fillable.amount > 0 ) {
+                     result = fill_rex_order( *bitr, fillable );
+                     idx.modify( oitr, same_payer, [&]( auto& order ) {
+                        order.rex_requested.amount -= fillable.amount;
+                        order.proceeds.amount      += result.proceeds.amount;
+                        order.stake_change.amount  += result.stake_change.amount;
+                     });
+                  }
                }
             }
             oitr = next;
@@ -619,7 +700,7 @@ namespace eosiosystem {
    template <typename T>
    int64_t system_contract::rent_rex( T& table, const name& from, const name& receiver, const asset& payment, const asset& fund )
    {
-      runrex(2);
+      runrex( rex_action_budget() );
 
       check( rex_loans_available(), "rex loans are currently not available" );
       check( payment.symbol == core_symbol() && fund.symbol == core_symbol(), "must use core token" );
@@ -660,13 +741,13 @@ namespace eosiosystem {
     * different function to complete order processing, i.e. transfer proceeds to user REX fund and
     * update user vote weight.
     *
-    * @param bitr - iterator pointing to rex_balance database record
+    * @param bal - rex_balance record of the order owner
     * @param rex - amount of rex to be sold
     *
     * @return rex_order_outcome - a struct containing success flag, order proceeds, and resultant
     * vote stake change
     */
-   rex_order_outcome system_contract::fill_rex_order( const rex_balance_table::const_iterator& bitr, const asset& rex )
+   rex_order_outcome system_contract::fill_rex_order( const rex_balance& bal, const asset& rex )
    {
       auto rexitr = _rexpool.begin();
       const int64_t S0 = rexitr->total_lendable.amount;
@@ -681,19 +762,19 @@ namespace eosiosystem {
       const int64_t unlent_lower_bound = ( uint128_t(2) * rexitr->total_lent.amount ) / 10;
       const int64_t available_unlent   = rexitr->total_unlent.amount - unlent_lower_bound; // available_unlent <= 0 is possible
       if ( proceeds.amount <= available_unlent ) {
-         const int64_t init_vote_stake_amount = bitr->vote_stake.amount;
-         const int64_t current_stake_value    = ( uint128_t(bitr->rex_balance.amount) * S0 ) / R0;
+         const int64_t init_vote_stake_amount = bal.vote_stake.amount;
+         const int64_t current_stake_value    = ( uint128_t(bal.rex_balance.amount) * S0 ) / R0;
          _rexpool.modify( rexitr, same_payer, [&]( auto& rt ) {
             rt.total_rex.amount      = R1;
             rt.total_lendable.amount = S1;
             rt.total_unlent.amount   = rt.total_lendable.amount - rt.total_lent.amount;
          });
-         _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
+         _rexbalance.modify( bal, same_payer, [&]( auto& rb ) {
             rb.vote_stake.amount   = current_stake_value - proceeds.amount;
             rb.rex_balance.amount -= rex.amount;
             rb.matured_rex        -= rex.amount;
          });
-         stake_change.amount = bitr->vote_stake.amount - init_vote_stake_amount;
+         stake_change.amount = bal.vote_stake.amount - init_vote_stake_amount;
          success = true;
       } else {
          proceeds.amount = 0;
@@ -702,6 +783,33 @@ namespace eosiosystem {
       return { success, proceeds, stake_change };
    }
 
+   /**
+    * @brief Returns the part of a sellrex order that can be filled now
+    *
+    * Largest amount of REX, up to `rex`, whose proceeds do not exceed the core tokens available
+    * in the REX pool. Zero is returned if these proceeds would be negligible.
+    *
+    * @param rex - amount of rex requested by the order
+    *
+    * @return asset - amount of rex that can be sold
+    */
+   asset system_contract::get_fillable_rex( const asset& rex )const
+   {
+      auto rexitr = _rexpool.begin();
+      const int64_t S0 = rexitr->total_lendable.amount;
+      const int64_t R0 = rexitr->total_rex.amount;
+
+      const int64_t unlent_lower_bound = ( uint128_t(2) * rexitr->total_lent.amount ) / 10;
+      const int64_t available_unlent   = rexitr->total_unlent.amount - unlent_lower_bound;
+      if ( available_unlent <= 0 || S0 <= 0 )
+         return asset( 0, rex.symbol );
+
+      const int64_t fillable = std::min( int64_t( ( uint128_t(available_unlent) * R0 ) / S0 ), rex.amount );
+      if ( ( uint128_t(fillable) * S0 ) / R0 == 0 )
+         return asset( 0, rex.symbol );
+      return asset( fillable, rex.symbol );
+   }
+
    template <typename T>
    void system_contract::fund_rex_loan( T& table, const name& from, uint64_t loan_num, const asset& payment  )
    {
@@ -864,12 +972,12 @@ namespace eosiosystem {
    /**
     * @brief Updates REX owner maturity buckets
     *
-    * @param bitr - iterator pointing to rex_balance object
+    * @param bal - rex_balance object
     */
-   void system_contract::process_rex_maturities( const rex_balance_table::const_iterator& bitr )
+   void system_contract::process_rex_maturities( const rex_balance& bal )
    {
       const time_point_sec now = current_time_point();
-      _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
+      _rexbalance.modify( bal, same_payer, [&]( auto& rb ) {
          while ( !rb.rex_maturities.empty() && rb.rex_maturities.front().first <= now ) {
             rb.matured_rex += rb.rex_maturities.front().second;
             rb.rex_maturities.pop_front();
@@ -880,14 +988,14 @@ namespace eosiosystem {
    /**
     * @brief Consolidates REX maturity buckets into one
     *
-    * @param bitr - iterator pointing to rex_balance object
+    * @param bal - rex_balance object
     * @param rex_in_sell_order - REX tokens in owner unfilled sell order, if one exists
     */
-   void system_contract::consolidate_rex_balance( const rex_balance_table::const_iterator& bitr,
+   void system_contract::consolidate_rex_balance( const rex_balance& bal,
                                                   const asset& rex_in_sell_order )
    {
-      const int64_t rex_in_savings = read_rex_savings( bitr );
-      _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
+      const int64_t rex_in_savings = read_rex_savings( bal );
+      _rexbalance.modify( bal, same_payer, [&]( auto& rb ) {
          int64_t total  = rb.matured_rex - rex_in_sell_order.amount;
          rb.matured_rex = rex_in_sell_order.amount;
          while ( !rb.rex_maturities.empty() ) {
@@ -898,7 +1006,7 @@ namespace eosiosystem {
             rb.rex_maturities.emplace_back( get_rex_maturity(), total );
          }
       });
-      put_rex_savings( bitr, rex_in_savings );
+      put_rex_savings( bal, rex_in_savings );
    }
 
    /**
@@ -975,8 +1083,8 @@ namespace eosiosystem {
       asset init_rex_stake( 0, core_symbol() );
       asset current_rex_stake( 0, core_symbol() );
       auto bitr = _rexbalance.find( owner.value );
-      if ( bitr == _rexbalance.end() ) {
-         bitr = _rexbalance.emplace( owner, [&]( auto& rb ) {
+      if ( bitr == nullptr ) {
+         bitr = &_rexbalance.emplace( owner, [&]( auto& rb ) {
             rb.owner       = owner;
             rb.vote_stake  = payment;
             rb.rex_balance = rex_received;
@@ -984,7 +1092,7 @@ namespace eosiosystem {
          current_rex_stake.amount = payment.amount;
       } else {
          init_rex_stake.amount = bitr->vote_stake.amount;
-         _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
+         _rexbalance.modify( *bitr, same_payer, [&]( auto& rb ) {
             rb.rex_balance.amount += rex_received.amount;
             rb.vote_stake.amount   = ( uint128_t(rb.rex_balance.amount) * _rexpool.begin()->total_lendable.amount )
                                      / _rexpool.begin()->total_rex.amount;
@@ -992,9 +1100,9 @@ namespace eosiosystem {
          current_rex_stake.amount = bitr->vote_stake.amount;
       }
 
-      const int64_t rex_in_savings = read_rex_savings( bitr );
-      process_rex_maturities( bitr );
-      _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
+      const int64_t rex_in_savings = read_rex_savings( *bitr );
+      process_rex_maturities( *bitr );
+      _rexbalance.modify( *bitr, same_payer, [&]( auto& rb ) {
          const time_point_sec maturity = get_rex_maturity();
          if ( !rb.rex_maturities.empty() && rb.rex_maturities.back().first == maturity ) {
             rb.rex_maturities.back().second += rex_received.amount;
@@ -1002,7 +1110,7 @@ namespace eosiosystem {
             rb.rex_maturities.emplace_back( maturity, rex_received.amount );
          }
       });
-      put_rex_savings( bitr, rex_in_savings );
+      put_rex_savings( *bitr, rex_in_savings );
       return current_rex_stake - init_rex_stake;
    }
 
@@ -1013,16 +1121,16 @@ namespace eosiosystem {
     * allow uniform processing of remaining buckets as savings is a special case. This
     * function is used in conjunction with put_rex_savings.
     *
-    * @param bitr - iterator pointing to rex_balance object
+    * @param bal - rex_balance object
     *
     * @return int64_t - amount of REX in savings bucket
     */
-   int64_t system_contract::read_rex_savings( const rex_balance_table::const_iterator& bitr )
+   int64_t system_contract::read_rex_savings( const rex_balance& bal )
    {
       int64_t rex_in_savings = 0;
       static const time_point_sec end_of_days = time_point_sec::maximum();
-      if ( !bitr->rex_maturities.empty() && bitr->rex_maturities.back().first == end_of_days ) {
-         _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
+      if ( !bal.rex_maturities.empty() && bal.rex_maturities.back().first == end_of_days ) {
+         _rexbalance.modify( bal, same_payer, [&]( auto& rb ) {
             rex_in_savings = rb.rex_maturities.back().second;
             rb.rex_maturities.pop_back();
          });
@@ -1033,14 +1141,14 @@ namespace eosiosystem {
    /**
     * @brief Adds a specified REX amount to savings bucket
     *
-    * @param bitr - iterator pointing to rex_balance object
+    * @param bal - rex_balance object
     * @param rex - amount of REX to be added
     */
-   void system_contract::put_rex_savings( const rex_balance_table::const_iterator& bitr, int64_t rex )
+   void system_contract::put_rex_savings( const rex_balance& bal, int64_t rex )
    {
       if ( rex == 0 ) return;
       static const time_point_sec end_of_days = time_point_sec::maximum();
-      _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
+      _rexbalance.modify( bal, same_payer, [&]( auto& rb ) {
          if ( !rb.rex_maturities.empty() && rb.rex_maturities.back().first == end_of_days ) {
             rb.rex_maturities.back().second += rex;
          } else {
@@ -1058,12 +1166,12 @@ namespace eosiosystem {
    {
       int64_t delta_stake = 0;
       auto bitr = _rexbalance.find( voter.value );
-      if ( bitr != _rexbalance.end() && rex_available() ) {
+      if ( bitr != nullptr && rex_available() ) {
          asset init_vote_stake = bitr->vote_stake;
          asset current_vote_stake( 0, core_symbol() );
          current_vote_stake.amount = ( uint128_t(bitr->rex_balance.amount) * _rexpool.begin()->total_lendable.amount )
                                      / _rexpool.begin()->total_rex.amount;
-         _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
+         _rexbalance.modify( *bitr, same_payer, [&]( auto& rb ) {
             rb.vote_stake.amount = current_vote_stake.amount;
          });
          delta_stake = current_vote_stake.amount - init_vote_stake.amount;
@@ -1071,8 +1179,8 @@ namespace eosiosystem {
 
       if ( delta_stake != 0 ) {
          auto vitr = _voters.find( voter.value );
-         if ( vitr != _voters.end() ) {
-            _voters.modify( vitr, same_payer, [&]( auto& vinfo ) {
+         if ( vitr != nullptr ) {
+            _voters.modify( *vitr, same_payer, [&]( auto& vinfo ) {
                vinfo.staked += delta_stake;
             });
          }
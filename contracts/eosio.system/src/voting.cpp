@@ -28,8 +28,8 @@ namespace eosiosystem {
       auto prod = _producers.find( producer.value );
       const auto ct = current_time_point();
 
-      if ( prod != _producers.end() ) {
-         _producers.modify( prod, producer, [&]( producer_info& info ){
+      if ( prod != nullptr ) {
+         _producers.modify( *prod, producer, [&]( producer_info& info ){
             info.producer_key = producer_key;
             info.is_active    = true;
             info.url          = url;
@@ -39,7 +39,7 @@ namespace eosiosystem {
          });
 
          auto prod2 = _producers2.find( producer.value );
-         if ( prod2 == _producers2.end() ) {
+         if ( prod2 == nullptr ) {
             _producers2.emplace( producer, [&]( producer_info2& info ){
                info.owner                     = producer;
                info.last_votepay_share_update = ct;
@@ -74,19 +74,47 @@ namespace eosiosystem {
       });
    }
 
+   /**
+    * Cheap 64-bit hash (FNV-1a with a final mix) of a producer's name and signing key. Summed over a schedule
+    * it gives a fingerprint independent of the order of the producers.
+    */
+   uint64_t producer_key_fingerprint( const eosio::producer_key& key ) {
+      constexpr uint64_t fnv_prime = 0x100000001b3ull;
+      uint64_t h = 0xcbf29ce484222325ull;
+      for( uint64_t v = key.producer_name.value, i = 0; i < 8; ++i, v >>= 8 ) {
+         h = ( h ^ (v & 0xff) ) * fnv_prime;
+      }
+      h = ( h ^ key.block_signing_key.type.value ) * fnv_prime;
+      for( const char c : key.block_signing_key.data ) {
+         h = ( h ^ static_cast<uint8_t>(c) ) * fnv_prime;
+      }
+      h ^= h >> 33;
+      h *= 0xff51afd7ed558ccdull;
+      h ^= h >> 33;
+      return h;
+   }
+
    void system_contract::update_elected_producers( const block_timestamp& block_time ) {
-      _gstate.last_producer_schedule_update = block_time;
+      mutable_gstate().last_producer_schedule_update = block_time;
 
-      auto idx = _producers.get_index<"prototalvote"_n>();
+      // table() writes pending producer updates before the secondary index is read
+      auto idx = _producers.table().get_index<"prototalvote"_n>();
 
       std::vector< std::pair<eosio::producer_key,uint16_t> > top_producers;
       top_producers.reserve(21);
 
+      uint64_t fingerprint = 0;
       for ( auto it = idx.cbegin(); it != idx.cend() && top_producers.size() < 21 && 0 < it->total_votes && it->active(); ++it ) {
          top_producers.emplace_back( std::pair<eosio::producer_key,uint16_t>({{it->owner, it->producer_key}, it->location}) );
+         fingerprint += producer_key_fingerprint( top_producers.back().first );
+      }
+
+      if ( top_producers.size() == 0 || top_producers.size() < gstate().last_producer_schedule_size ) {
+         return;
       }
 
-      if ( top_producers.size() == 0 || top_producers.size() < _gstate.last_producer_schedule_size ) {
+      /// the elected producers have not changed since the last accepted proposal
+      if ( fingerprint == gstate4().last_proposed_schedule_fingerprint ) {
          return;
       }
 
@@ -100,56 +128,120 @@ namespace eosiosystem {
          producers.push_back(item.first);
 
       if( set_proposed_producers( producers ) >= 0 ) {
-         _gstate.last_producer_schedule_size = static_cast<decltype(_gstate.last_producer_schedule_size)>( top_producers.size() );
+         mutable_gstate().last_producer_schedule_size = static_cast<decltype(_gstate.last_producer_schedule_size)>( top_producers.size() );
+         mutable_gstate4().last_proposed_schedule_fingerprint = fingerprint;
       }
    }
 
+   /**
+    * Vote weight multipliers 2^(k/52) for every week k of a year, correctly rounded. The vote weight doubles
+    * every 52 weeks, so the multiplier of any week is an entry of this table scaled by an exact power of two.
+    *
+    * The multipliers may differ by 1 ulp from the std::pow( 2, weeks / 52. ) used before (weeks 30, 35 and 48
+    * of every year). This is accepted: a vote weight is only ever removed as the last_vote_weight stored with
+    * it, so the difference does not accumulate in producer or proxy totals.
+    */
+   static constexpr double weekly_vote_weight[52] = {
+      1.0,                 1.0134189906987003,  1.0270180507087725,  1.0407995963786307,
+      1.0547660764816467,  1.0689199726512586,  1.0832637998219208,  1.09780010667597,
+      1.1125314760964868,  1.127460525626237,   1.1425899079327673,  1.1579223112797459,
+      1.1734604600046263,  1.189207115002721,   1.2051650742177709,  1.2213371731390976,
+      1.237726285305428,   1.2543353228154785,  1.2711672368453906,  1.2882250181731114,
+      1.3055116977098096,  1.323030347038422,   1.3407840789594287,  1.3587760480439508,
+      1.3770094511942694,  1.3954875282118677,  1.4142135623730951,  1.4331908810125555,
+      1.452422856114325,   1.4719129049111028,  1.491664490491402,   1.5116811224148876,
+      1.5319663573359739,  1.552523799635787,   1.5733571020626107,  1.5944699663809228,
+      1.6158661440291455,  1.6375494367862173,  1.6595236974471135,  1.681792830507429,
+      1.7043607928571491,  1.7272315944837286,  1.7504092991846072,  1.773898025289284,
+      1.7977019463910837,  1.8218252920887412,  1.8462723487379369,  1.871047460212919,
+      1.8961550286783428,  1.9215995153714713,  1.9473854413948684,  1.9735173885197304
+   };
+
    double stake2vote( int64_t staked ) {
       /// TODO subtract 2080 brings the large numbers closer to this decade
-      double weight = int64_t( (current_time_point().sec_since_epoch() - (block_timestamp::block_timestamp_epoch / 1000)) / (seconds_per_day * 7) )  / double( 52 );
-      return double(staked) * std::pow( 2, weight );
+      /// the current week does not change within an action, compute its multiplier once
+      static const double weight = [] {
+         const int64_t weeks = int64_t( (current_time_point().sec_since_epoch() - (block_timestamp::block_timestamp_epoch / 1000)) / (seconds_per_day * 7) );
+         return std::ldexp( weekly_vote_weight[weeks % 52], int( weeks / 52 ) );
+      }();
+      return double(staked) * weight;
+   }
+
+   /**
+    * Merge-joins the sorted and unique list of `producers` into the sorted delta set, adding `vote_weight`
+    * to each of them.
+    */
+   void merge_producer_vote_deltas( producer_vote_deltas& deltas, const std::vector<name>& producers,
+                                    double vote_weight, bool new_vote, bool proxied )
+   {
+      producer_vote_deltas merged;
+      merged.reserve( deltas.size() + producers.size() );
+
+      auto d = deltas.cbegin();
+      auto p = producers.cbegin();
+      while( d != deltas.cend() || p != producers.cend() ) {
+         if( p == producers.cend() || ( d != deltas.cend() && d->producer < *p ) ) {
+            merged.push_back( *d++ );
+            continue;
+         }
+         if( d != deltas.cend() && d->producer == *p ) {
+            merged.push_back( *d++ );
+         } else {
+            merged.push_back( producer_vote_delta{ *p } );
+         }
+         auto& m = merged.back();
+         m.vote_weight += vote_weight;
+         m.new_vote    |= new_vote;
+         m.proxied     |= proxied;
+         ++p;
+      }
+
+      deltas = std::move( merged );
    }
 
    double system_contract::update_total_votepay_share( const time_point& ct,
                                                        double additional_shares_delta,
                                                        double shares_rate_delta )
    {
+      auto& gstate2 = mutable_gstate2();
+      auto& gstate3 = mutable_gstate3();
+
       double delta_total_votepay_share = 0.0;
-      if( ct > _gstate3.last_vpay_state_update ) {
-         delta_total_votepay_share = _gstate3.total_vpay_share_change_rate
-                                       * double( (ct - _gstate3.last_vpay_state_update).count() / 1E6 );
+      if( ct > gstate3.last_vpay_state_update ) {
+         delta_total_votepay_share = gstate3.total_vpay_share_change_rate
+                                       * double( (ct - gstate3.last_vpay_state_update).count() / 1E6 );
       }
 
       delta_total_votepay_share += additional_shares_delta;
-      if( delta_total_votepay_share < 0 && _gstate2.total_producer_votepay_share < -delta_total_votepay_share ) {
-         _gstate2.total_producer_votepay_share = 0.0;
+      if( delta_total_votepay_share < 0 && gstate2.total_producer_votepay_share < -delta_total_votepay_share ) {
+         gstate2.total_producer_votepay_share = 0.0;
       } else {
-         _gstate2.total_producer_votepay_share += delta_total_votepay_share;
+         gstate2.total_producer_votepay_share += delta_total_votepay_share;
       }
 
-      if( shares_rate_delta < 0 && _gstate3.total_vpay_share_change_rate < -shares_rate_delta ) {
-         _gstate3.total_vpay_share_change_rate = 0.0;
+      if( shares_rate_delta < 0 && gstate3.total_vpay_share_change_rate < -shares_rate_delta ) {
+         gstate3.total_vpay_share_change_rate = 0.0;
       } else {
-         _gstate3.total_vpay_share_change_rate += shares_rate_delta;
+         gstate3.total_vpay_share_change_rate += shares_rate_delta;
       }
 
-      _gstate3.last_vpay_state_update = ct;
+      gstate3.last_vpay_state_update = ct;
 
-      return _gstate2.total_producer_votepay_share;
+      return gstate2.total_producer_votepay_share;
    }
 
-   double system_contract::update_producer_votepay_share( const producers_table2::const_iterator& prod_itr,
+   double system_contract::update_producer_votepay_share( const producer_info2& prod2,
                                                           const time_point& ct,
                                                           double shares_rate,
                                                           bool reset_to_zero )
    {
       double delta_votepay_share = 0.0;
-      if( shares_rate > 0.0 && ct > prod_itr->last_votepay_share_update ) {
-         delta_votepay_share = shares_rate * double( (ct - prod_itr->last_votepay_share_update).count() / 1E6 ); // cannot be negative
+      if( shares_rate > 0.0 && ct > prod2.last_votepay_share_update ) {
+         delta_votepay_share = shares_rate * double( (ct - prod2.last_votepay_share_update).count() / 1E6 ); // cannot be negative
       }
 
-      double new_votepay_share = prod_itr->votepay_share + delta_votepay_share;
-      _producers2.modify( prod_itr, same_payer, [&](auto& p) {
+      double new_votepay_share = prod2.votepay_share + delta_votepay_share;
+      _producers2.modify( prod2, same_payer, [&](auto& p) {
          if( reset_to_zero )
             p.votepay_share = 0.0;
          else
@@ -166,7 +258,7 @@ namespace eosiosystem {
       vote_stake_updater( voter_name );
       update_votes( voter_name, proxy, producers, true );
       auto rex_itr = _rexbalance.find( voter_name.value );
-      if( rex_itr != _rexbalance.end() && rex_itr->rex_balance.amount > 0 ) {
+      if( rex_itr != nullptr && rex_itr->rex_balance.amount > 0 ) {
          check_voting_requirement( voter_name, "voter holding REX tokens must vote for at least 21 producers or for a proxy" );
       }
    }
@@ -184,7 +276,7 @@ namespace eosiosystem {
       }
 
       auto voter = _voters.find( voter_name.value );
-      check( voter != _voters.end(), "user must stake before they can vote" ); /// staking creates voter object
+      check( voter != nullptr, "user must stake before they can vote" ); /// staking creates voter object
       check( !proxy || !voter->is_proxy, "account registered as a proxy is not allowed to use a proxy" );
 
       /**
@@ -193,9 +285,10 @@ namespace eosiosystem {
        * their first vote and should consider their stake activated.
        */
       if( voter->last_vote_weight <= 0.0 ) {
-         _gstate.total_activated_stake += voter->staked;
-         if( _gstate.total_activated_stake >= min_activated_stake && _gstate.thresh_activated_stake_time == time_point() ) {
-            _gstate.thresh_activated_stake_time = current_time_point();
+         auto& gs = mutable_gstate();
+         gs.total_activated_stake += voter->staked;
+         if( gs.total_activated_stake >= min_activated_stake && gs.thresh_activated_stake_time == time_point() ) {
+            gs.thresh_activated_stake_time = current_time_point();
          }
       }
 
@@ -204,92 +297,39 @@ namespace eosiosystem {
          new_vote_weight += voter->proxied_vote_weight;
       }
 
-      std::map<name, std::pair<double, bool /*new*/> > producer_deltas;
+      producer_vote_deltas producer_deltas;
       if ( voter->last_vote_weight > 0 ) {
          if( voter->proxy ) {
             auto old_proxy = _voters.find( voter->proxy.value );
-            check( old_proxy != _voters.end(), "old proxy not found" ); //data corruption
-            _voters.modify( old_proxy, same_payer, [&]( auto& vp ) {
+            check( old_proxy != nullptr, "old proxy not found" ); //data corruption
+            _voters.modify( *old_proxy, same_payer, [&]( auto& vp ) {
                   vp.proxied_vote_weight -= voter->last_vote_weight;
                });
-            propagate_weight_change( *old_proxy );
+            propagate_weight_change( *old_proxy, producer_deltas );
          } else {
-            for( const auto& p : voter->producers ) {
-               auto& d = producer_deltas[p];
-               d.first -= voter->last_vote_weight;
-               d.second = false;
-            }
+            merge_producer_vote_deltas( producer_deltas, voter->producers, -voter->last_vote_weight, false, false );
          }
       }
 
       if( proxy ) {
          auto new_proxy = _voters.find( proxy.value );
-         check( new_proxy != _voters.end(), "invalid proxy specified" ); //if ( !voting ) { data corruption } else { wrong vote }
+         check( new_proxy != nullptr, "invalid proxy specified" ); //if ( !voting ) { data corruption } else { wrong vote }
          check( !voting || new_proxy->is_proxy, "proxy not found" );
          if ( new_vote_weight >= 0 ) {
-            _voters.modify( new_proxy, same_payer, [&]( auto& vp ) {
+            _voters.modify( *new_proxy, same_payer, [&]( auto& vp ) {
                   vp.proxied_vote_weight += new_vote_weight;
                });
-            propagate_weight_change( *new_proxy );
+            propagate_weight_change( *new_proxy, producer_deltas );
          }
       } else {
          if( new_vote_weight >= 0 ) {
-            for( const auto& p : producers ) {
-               auto& d = producer_deltas[p];
-               d.first += new_vote_weight;
-               d.second = true;
-            }
-         }
-      }
-
-      const auto ct = current_time_point();
-      double delta_change_rate         = 0.0;
-      double total_inactive_vpay_share = 0.0;
-      for( const auto& pd : producer_deltas ) {
-         auto pitr = _producers.find( pd.first.value );
-         if( pitr != _producers.end() ) {
-            if( voting && !pitr->active() && pd.second.second /* from new set */ ) {
-               check( false, ( "producer " + pitr->owner.to_string() + " is not currently registered" ).data() );
-            }
-            double init_total_votes = pitr->total_votes;
-            _producers.modify( pitr, same_payer, [&]( auto& p ) {
-               p.total_votes += pd.second.first;
-               if ( p.total_votes < 0 ) { // floating point arithmetics can give small negative numbers
-                  p.total_votes = 0;
-               }
-               _gstate.total_producer_vote_weight += pd.second.first;
-               //check( p.total_votes >= 0, "something bad happened" );
-            });
-            auto prod2 = _producers2.find( pd.first.value );
-            if( prod2 != _producers2.end() ) {
-               const auto last_claim_plus_3days = pitr->last_claim_time + microseconds(3 * useconds_per_day);
-               bool crossed_threshold       = (last_claim_plus_3days <= ct);
-               bool updated_after_threshold = (last_claim_plus_3days <= prod2->last_votepay_share_update);
-               // Note: updated_after_threshold implies cross_threshold
-
-               double new_votepay_share = update_producer_votepay_share( prod2,
-                                             ct,
-                                             updated_after_threshold ? 0.0 : init_total_votes,
-                                             crossed_threshold && !updated_after_threshold // only reset votepay_share once after threshold
-                                          );
-
-               if( !crossed_threshold ) {
-                  delta_change_rate += pd.second.first;
-               } else if( !updated_after_threshold ) {
-                  total_inactive_vpay_share += new_votepay_share;
-                  delta_change_rate -= init_total_votes;
-               }
-            }
-         } else {
-            if( pd.second.second ) {
-               check( false, ( "producer " + pd.first.to_string() + " is not registered" ).data() );
-            }
+            merge_producer_vote_deltas( producer_deltas, producers, new_vote_weight, true, false );
          }
       }
 
-      update_total_votepay_share( ct, -total_inactive_vpay_share, delta_change_rate );
+      update_producer_votes( producer_deltas, voting );
 
-      _voters.modify( voter, same_payer, [&]( auto& av ) {
+      _voters.modify( *voter, same_payer, [&]( auto& av ) {
          av.last_vote_weight = new_vote_weight;
          av.producers = producers;
          av.proxy     = proxy;
@@ -300,13 +340,17 @@ namespace eosiosystem {
       require_auth( proxy );
 
       auto pitr = _voters.find( proxy.value );
-      if ( pitr != _voters.end() ) {
+      if ( pitr != nullptr ) {
          check( isproxy != pitr->is_proxy, "action has no effect" );
          check( !isproxy || !pitr->proxy, "account that uses a proxy is not allowed to become a proxy" );
-         _voters.modify( pitr, same_payer, [&]( auto& p ) {
+         _voters.modify( *pitr, same_payer, [&]( auto& p ) {
                p.is_proxy = isproxy;
             });
-         propagate_weight_change( *pitr );
+         producer_vote_deltas producer_deltas;
+         propagate_weight_change( *pitr, producer_deltas );
+         if ( !producer_deltas.empty() ) {
+            update_producer_votes( producer_deltas, false );
+         }
       } else {
          _voters.emplace( proxy, [&]( auto& p ) {
                p.owner  = proxy;
@@ -315,7 +359,11 @@ namespace eosiosystem {
       }
    }
 
-   void system_contract::propagate_weight_change( const voter_info& voter ) {
+   /**
+    * Walks up the proxy chain of `voter` and accumulates the resulting change of producer votes
+    * into `producer_deltas`, producer rows are updated by the caller through update_producer_votes.
+    */
+   void system_contract::propagate_weight_change( const voter_info& voter, producer_vote_deltas& producer_deltas ) {
       check( !voter.proxy || !voter.is_proxy, "account registered as a proxy is not allowed to use a proxy" );
       double new_weight = stake2vote( voter.staked );
       if ( voter.is_proxy ) {
@@ -330,42 +378,10 @@ namespace eosiosystem {
                   p.proxied_vote_weight += new_weight - voter.last_vote_weight;
                }
             );
-            propagate_weight_change( proxy );
+            propagate_weight_change( proxy, producer_deltas );
          } else {
             auto delta = new_weight - voter.last_vote_weight;
-            const auto ct = current_time_point();
-            double delta_change_rate         = 0;
-            double total_inactive_vpay_share = 0;
-            for ( auto acnt : voter.producers ) {
-               auto& prod = _producers.get( acnt.value, "producer not found" ); //data corruption
-               const double init_total_votes = prod.total_votes;
-               _producers.modify( prod, same_payer, [&]( auto& p ) {
-                  p.total_votes += delta;
-                  _gstate.total_producer_vote_weight += delta;
-               });
-               auto prod2 = _producers2.find( acnt.value );
-               if ( prod2 != _producers2.end() ) {
-                  const auto last_claim_plus_3days = prod.last_claim_time + microseconds(3 * useconds_per_day);
-                  bool crossed_threshold       = (last_claim_plus_3days <= ct);
-                  bool updated_after_threshold = (last_claim_plus_3days <= prod2->last_votepay_share_update);
-                  // Note: updated_after_threshold implies cross_threshold
-
-                  double new_votepay_share = update_producer_votepay_share( prod2,
-                                                ct,
-                                                updated_after_threshold ? 0.0 : init_total_votes,
-                                                crossed_threshold && !updated_after_threshold // only reset votepay_share once after threshold
-                                             );
-
-                  if( !crossed_threshold ) {
-                     delta_change_rate += delta;
-                  } else if( !updated_after_threshold ) {
-                     total_inactive_vpay_share += new_votepay_share;
-                     delta_change_rate -= init_total_votes;
-                  }
-               }
-            }
-
-            update_total_votepay_share( ct, -total_inactive_vpay_share, delta_change_rate );
+            merge_producer_vote_deltas( producer_deltas, voter.producers, delta, false, true );
          }
       }
       _voters.modify( voter, same_payer, [&]( auto& v ) {
@@ -374,4 +390,58 @@ namespace eosiosystem {
       );
    }
 
+   /**
+    * Applies the accumulated producer vote changes of an action, each producer row and the global
+    * votepay totals are updated once.
+    */
+   void system_contract::update_producer_votes( const producer_vote_deltas& producer_deltas, bool voting ) {
+      const auto ct = current_time_point();
+      double delta_change_rate         = 0.0;
+      double total_inactive_vpay_share = 0.0;
+      for( const auto& pd : producer_deltas ) {
+         auto pitr = _producers.find( pd.producer.value );
+         if( pitr != nullptr ) {
+            if( voting && !pitr->active() && pd.new_vote ) {
+               check( false, ( "producer " + pitr->owner.to_string() + " is not currently registered" ).data() );
+            }
+            double init_total_votes = pitr->total_votes;
+            _producers.modify( *pitr, same_payer, [&]( auto& p ) {
+               p.total_votes += pd.vote_weight;
+               if ( p.total_votes < 0 ) { // floating point arithmetics can give small negative numbers
+                  p.total_votes = 0;
+               }
+               mutable_gstate().total_producer_vote_weight += pd.vote_weight;
+               //check( p.total_votes >= 0, "something bad happened" );
+            });
+            auto prod2 = _producers2.find( pd.producer.value );
+            if( prod2 != nullptr ) {
+               const auto last_claim_plus_3days = pitr->last_claim_time + microseconds(3 * useconds_per_day);
+               bool crossed_threshold       = (last_claim_plus_3days <= ct);
+               bool updated_after_threshold = (last_claim_plus_3days <= prod2->last_votepay_share_update);
+               // Note: updated_after_threshold implies cross_threshold
+
+               double new_votepay_share = update_producer_votepay_share( *prod2,
+                                             ct,
+                                             updated_after_threshold ? 0.0 : init_total_votes,
+                                             crossed_threshold && !updated_after_threshold // only reset votepay_share once after threshold
+                                          );
+
+               if( !crossed_threshold ) {
+                  delta_change_rate += pd.vote_weight;
+               } else if( !updated_after_threshold ) {
+                  total_inactive_vpay_share += new_votepay_share;
+                  delta_change_rate -= init_total_votes;
+               }
+            }
+         } else {
+            if( pd.new_vote ) {
+               check( false, ( "producer " + pd.producer.to_string() + " is not registered" ).data() );
+            }
+            check( !pd.proxied, "producer not found" ); //data corruption
+         }
+      }
+
+      update_total_votepay_share( ct, -total_inactive_vpay_share, delta_change_rate );
+   }
+
 } /// namespace eosiosystem
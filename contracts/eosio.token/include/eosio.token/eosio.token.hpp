@@ -4,6 +4,7 @@
 #include <eosio/eosio.hpp>
 
 #include <string>
+#include <vector>
 
 namespace eosiosystem {
    class system_contract;
@@ -21,8 +22,23 @@ namespace eosio {
     *
     * @details eosio.token contract defines the structures and actions that allow users to create, issue, and manage
     * tokens on eosio based blockchains.
+    *
+    * Off-chain applications read balances and supplies with the `get_currency_balance` and
+    * `get_currency_stats` RPC calls, or with `get_table_rows` on the `accounts` and `stat` tables. These calls
+    * are free and add nothing to the chain, so the contract does not provide query actions.
     * @{
     */
+   /**
+    * A single transfer of a `transfers` batch.
+    */
+   struct token_transfer {
+      name     to;
+      asset    quantity;
+      string   memo;
+
+      EOSLIB_SERIALIZE( token_transfer, (to)(quantity)(memo) )
+   };
+
    class [[eosio::contract("eosio.token")]] token : public contract {
       public:
          using contract::contract;
@@ -84,6 +100,21 @@ namespace eosio {
                         const name&    to,
                         const asset&   quantity,
                         const string&  memo );
+
+         /**
+          * Transfers action.
+          *
+          * @details Allows `from` account to transfer tokens to several accounts at once. Each recipient is
+          * credited as with the transfer action, while `from` is debited once per token.
+          * Recipients are notified of the `transfers` action, not of a `transfer` action, so contracts that
+          * only handle `transfer` notifications do not see these deposits and should not be paid this way.
+          *
+          * @param from - the account to transfer from,
+          * @param transfers - the recipient, quantity and memo of each transfer.
+          */
+         [[eosio::action]]
+         void transfers( const name& from, const std::vector<token_transfer>& transfers );
+
          /**
           * Open action.
           *
@@ -151,6 +182,7 @@ namespace eosio {
          using issue_action = eosio::action_wrapper<"issue"_n, &token::issue>;
          using retire_action = eosio::action_wrapper<"retire"_n, &token::retire>;
          using transfer_action = eosio::action_wrapper<"transfer"_n, &token::transfer>;
+         using transfers_action = eosio::action_wrapper<"transfers"_n, &token::transfers>;
          using open_action = eosio::action_wrapper<"open"_n, &token::open>;
          using close_action = eosio::action_wrapper<"close"_n, &token::close>;
       private:
@@ -171,7 +203,9 @@ namespace eosio {
          typedef eosio::multi_index< "accounts"_n, account > accounts;
          typedef eosio::multi_index< "stat"_n, currency_stats > stats;
 
+         symbol get_token_symbol( accounts& acnts, const symbol_code& sym_code )const;
          void sub_balance( const name& owner, const asset& value );
+         void sub_balance( accounts& from_acnts, const name& owner, const asset& value );
          void add_balance( const name& owner, const asset& value, const name& ram_payer );
    };
    /** @}*/ // end of @defgroup eosiotoken eosio.token
@@ -1,5 +1,7 @@
 #include <eosio.token/eosio.token.hpp>
 
+#include <algorithm>
+
 namespace eosio {
 
 void token::create( const name&   issuer,
@@ -82,27 +84,77 @@ void token::transfer( const name&    from,
     check( from != to, "cannot transfer to self" );
     require_auth( from );
     check( is_account( to ), "to account does not exist");
-    auto sym = quantity.symbol.code();
-    stats statstable( get_self(), sym.raw() );
-    const auto& st = statstable.get( sym.raw() );
+    accounts from_acnts( get_self(), from.value );
+    const symbol token_symbol = get_token_symbol( from_acnts, quantity.symbol.code() );
 
     require_recipient( from );
     require_recipient( to );
 
     check( quantity.is_valid(), "invalid quantity" );
     check( quantity.amount > 0, "must transfer positive quantity" );
-    check( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
+    check( quantity.symbol == token_symbol, "symbol precision mismatch" );
     check( memo.size() <= 256, "memo has more than 256 bytes" );
 
     auto payer = has_auth( to ) ? to : from;
 
-    sub_balance( from, quantity );
+    sub_balance( from_acnts, from, quantity );
     add_balance( to, quantity, payer );
 }
 
+void token::transfers( const name& from, const std::vector<token_transfer>& transfers )
+{
+    require_auth( from );
+    check( !transfers.empty(), "no transfers" );
+    require_recipient( from );
+
+    accounts from_acnts( get_self(), from.value );
+    std::vector<asset> totals; // sender debit per token
+    for( const auto& t : transfers ) {
+       check( from != t.to, "cannot transfer to self" );
+       check( is_account( t.to ), "to account does not exist");
+       require_recipient( t.to );
+
+       check( t.quantity.is_valid(), "invalid quantity" );
+       check( t.quantity.amount > 0, "must transfer positive quantity" );
+       check( t.memo.size() <= 256, "memo has more than 256 bytes" );
+
+       auto total = std::find_if( totals.begin(), totals.end(), [&]( const asset& a ) {
+          return a.symbol.code() == t.quantity.symbol.code();
+       });
+       if( total == totals.end() ) {
+          check( t.quantity.symbol == get_token_symbol( from_acnts, t.quantity.symbol.code() ), "symbol precision mismatch" );
+          totals.push_back( t.quantity );
+       } else {
+          check( t.quantity.symbol == total->symbol, "symbol precision mismatch" );
+          *total += t.quantity;
+       }
+
+       add_balance( t.to, t.quantity, has_auth( t.to ) ? t.to : from );
+    }
+
+    for( const auto& total : totals ) {
+       sub_balance( from_acnts, from, total );
+    }
+}
+
+symbol token::get_token_symbol( accounts& acnts, const symbol_code& sym_code )const
+{
+   // a balance row carries the symbol of the token including its precision,
+   // the stat row is only read if there is no balance row
+   auto it = acnts.find( sym_code.raw() );
+   if( it != acnts.end() )
+      return it->balance.symbol;
+
+   stats statstable( get_self(), sym_code.raw() );
+   return statstable.get( sym_code.raw() ).supply.symbol;
+}
+
 void token::sub_balance( const name& owner, const asset& value ) {
    accounts from_acnts( get_self(), owner.value );
+   sub_balance( from_acnts, owner, value );
+}
 
+void token::sub_balance( accounts& from_acnts, const name& owner, const asset& value ) {
    const auto& from = from_acnts.get( value.symbol.code().raw(), "no balance object found" );
    check( from.balance.amount >= value.amount, "overdrawn balance" );
 
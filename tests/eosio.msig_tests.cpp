@@ -259,6 +259,105 @@ BOOST_FIXTURE_TEST_CASE( propose_approve_unapprove, eosio_msig_tester ) try {
 } FC_LOG_AND_RETHROW()
 
 
+BOOST_FIXTURE_TEST_CASE( propose_approve_unapprove_many_requested, eosio_msig_tester ) try {
+   auto trx = reqauth("alice", vector<permission_level>{ { N(alice), config::active_name },  { N(bob), config::active_name } }, abi_serializer_max_time );
+
+   // more requested approvals than fit in one approvals row, approvals are stored one row per level
+   vector<permission_level> requested = { { N(alice), config::active_name }, { N(bob), config::active_name } };
+   for ( char c = 'a'; c <= 'z'; ++c ) {
+      requested.push_back( permission_level{ name(std::string("membera") + c), config::active_name } );
+      requested.push_back( permission_level{ name(std::string("memberb") + c), config::active_name } );
+   }
+
+   for ( auto proposal_name : { N(first), N(second) } ) {
+      push_action( N(alice), N(propose), mvo()
+                     ("proposer",      "alice")
+                     ("proposal_name", proposal_name)
+                     ("trx",           trx)
+                     ("requested",     requested)
+      );
+   }
+   BOOST_REQUIRE_EQUAL( false, get_row_by_account( N(eosio.msig), N(alice), N(approvals3), N(first) ).empty() );
+   BOOST_REQUIRE_EQUAL( true,  get_row_by_account( N(eosio.msig), N(alice), N(approvals2), N(first) ).empty() );
+
+   push_action( N(alice), N(approve), mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "first")
+                  ("level",         permission_level{ N(alice), config::active_name })
+   );
+   push_action( N(bob), N(approve), mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "first")
+                  ("level",         permission_level{ N(bob), config::active_name })
+   );
+   BOOST_REQUIRE_EXCEPTION( push_action( N(bob), N(approve), mvo()
+                                          ("proposer",      "alice")
+                                          ("proposal_name", "first")
+                                          ("level",         permission_level{ N(bob), config::active_name })
+                            ),
+                            eosio_assert_message_exception,
+                            eosio_assert_message_is("approval is not on the list of requested approvals")
+   );
+   push_action( N(bob), N(unapprove), mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "first")
+                  ("level",         permission_level{ N(bob), config::active_name })
+   );
+   BOOST_REQUIRE_EXCEPTION( push_action( N(bob), N(unapprove), mvo()
+                                          ("proposer",      "alice")
+                                          ("proposal_name", "first")
+                                          ("level",         permission_level{ N(bob), config::active_name })
+                            ),
+                            eosio_assert_message_exception,
+                            eosio_assert_message_is("no approval previously granted")
+   );
+
+   //fail to execute without bob's approval
+   BOOST_REQUIRE_EXCEPTION( push_action( N(alice), N(exec), mvo()
+                                          ("proposer",      "alice")
+                                          ("proposal_name", "first")
+                                          ("executer",      "alice")
+                            ),
+                            eosio_assert_message_exception,
+                            eosio_assert_message_is("transaction authorization failed")
+   );
+
+   push_action( N(bob), N(approve), mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "first")
+                  ("level",         permission_level{ N(bob), config::active_name })
+   );
+
+   transaction_trace_ptr trace;
+   control->applied_transaction.connect(
+   [&]( std::tuple<const transaction_trace_ptr&, const signed_transaction&> p ) {
+      const auto& t = std::get<0>(p);
+      if( t->scheduled ) { trace = t; }
+   } );
+   push_action( N(alice), N(exec), mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "first")
+                  ("executer",      "alice")
+   );
+
+   BOOST_REQUIRE( bool(trace) );
+   BOOST_REQUIRE_EQUAL( 1, trace->action_traces.size() );
+   BOOST_REQUIRE_EQUAL( transaction_receipt::executed, trace->receipt->status );
+   BOOST_REQUIRE_EQUAL( true, get_row_by_account( N(eosio.msig), N(alice), N(approvals3), N(first) ).empty() );
+
+   // canceling removes the header and all approval rows
+   push_action( N(alice), N(cancel), mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "second")
+                  ("canceler",      "alice")
+   );
+   BOOST_REQUIRE_EQUAL( true, get_row_by_account( N(eosio.msig), N(alice), N(approvals3), N(second) ).empty() );
+   for ( uint64_t id = 0; id < 2 * requested.size(); ++id ) {
+      BOOST_REQUIRE_EQUAL( true, get_row_by_account( N(eosio.msig), N(alice), N(approvalrows), name(id) ).empty() );
+   }
+} FC_LOG_AND_RETHROW()
+
+
 BOOST_FIXTURE_TEST_CASE( propose_approve_by_two, eosio_msig_tester ) try {
    auto trx = reqauth("alice", vector<permission_level>{ { N(alice), config::active_name }, { N(bob), config::active_name } }, abi_serializer_max_time );
    push_action( N(alice), N(propose), mvo()
@@ -906,6 +1005,12 @@ BOOST_FIXTURE_TEST_CASE( approve_with_hash, eosio_msig_tester ) try {
                   ("requested", vector<permission_level>{{ N(alice), config::active_name }})
    );
 
+   //transaction hash is stored with the proposal
+   {
+      vector<char> data = get_row_by_account( N(eosio.msig), N(alice), N(prophash), N(first) );
+      BOOST_REQUIRE( trx_hash == abi_ser.binary_to_variant( "proposal_hash_info", data, abi_serializer_max_time )["proposal_hash"].as<fc::sha256>() );
+   }
+
    //fail to approve with incorrect hash
    BOOST_REQUIRE_EXCEPTION( push_action( N(alice), N(approve), mvo()
                                           ("proposer",      "alice")
@@ -941,6 +1046,7 @@ BOOST_FIXTURE_TEST_CASE( approve_with_hash, eosio_msig_tester ) try {
    BOOST_REQUIRE( bool(trace) );
    BOOST_REQUIRE_EQUAL( 1, trace->action_traces.size() );
    BOOST_REQUIRE_EQUAL( transaction_receipt::executed, trace->receipt->status );
+   BOOST_REQUIRE( get_row_by_account( N(eosio.msig), N(alice), N(prophash), N(first) ).empty() );
 } FC_LOG_AND_RETHROW()
 
 BOOST_FIXTURE_TEST_CASE( switch_proposal_and_fail_approve_with_hash, eosio_msig_tester ) try {
@@ -464,6 +464,20 @@ public:
       return rented_tokens;
    }
 
+   asset get_quote( const account_name& signer, const action_name& name, const variant_object& data ) {
+      auto trace = base_tester::push_action( config::system_account_name, name, signer, data );
+      asset quote;
+      for ( size_t i = 0; i < trace->action_traces.size(); ++i ) {
+         if ( trace->action_traces[i].act.name == N(quoteresult) ) {
+            fc::raw::unpack( trace->action_traces[i].act.data.data(),
+                             trace->action_traces[i].act.data.size(),
+                             quote );
+            return quote;
+         }
+      }
+      return quote;
+   }
+
    asset get_rentcpu_result( const account_name& from, const account_name& receiver, const asset& payment ) {
       return _get_rentrex_result( from, receiver, payment, true );
    }
@@ -670,6 +684,11 @@ public:
                           );
    }
 
+   fc::variant get_top_name_bid() {
+      vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, N(topbid), N(topbid) );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "top_name_bid", data, abi_serializer_max_time );
+   }
+
    static fc::variant_object producer_parameters_example( int n ) {
       return mutable_variant_object()
          ("max_block_net_usage", 10000000 + n )
@@ -730,6 +749,32 @@ public:
       return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "voter_info", data, abi_serializer_max_time );
    }
 
+   // unpaid blocks held in the unpaidblocks table and not yet added to the producers table and global state,
+   // of `act` or of all registered producers if `act` is empty
+   uint32_t get_pending_unpaid_blocks( const account_name& act = account_name() ) {
+      if( act != account_name() ) {
+         vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, N(unpaidblocks), act );
+         return data.empty() ? 0 : abi_ser.binary_to_variant( "producer_unpaid_blocks", data, abi_serializer_max_time )["blocks"].as<uint32_t>();
+      }
+
+      const auto& db = control->db();
+      namespace chain = eosio::chain;
+      const auto* t_id = db.find<eosio::chain::table_id_object, chain::by_code_scope_table>( boost::make_tuple( config::system_account_name, config::system_account_name, N(unpaidblocks) ) );
+      if ( !t_id ) {
+         return 0;
+      }
+
+      const auto& idx = db.get_index<chain::key_value_index, chain::by_scope_primary>();
+      uint32_t blocks = 0;
+      for ( auto itr = idx.lower_bound( boost::make_tuple( t_id->id, uint64_t(0) ) ); itr != idx.end() && itr->t_id == t_id->id; ++itr ) {
+         if ( !get_row_by_account( config::system_account_name, config::system_account_name, N(producers), account_name(itr->primary_key) ).empty() ) {
+            vector<char> data( itr->value.begin(), itr->value.end() );
+            blocks += abi_ser.binary_to_variant( "producer_unpaid_blocks", data, abi_serializer_max_time )["blocks"].as<uint32_t>();
+         }
+      }
+      return blocks;
+   }
+
    fc::variant get_producer_info( const account_name& act ) {
       vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, N(producers), act );
       return abi_ser.binary_to_variant( "producer_info", data, abi_serializer_max_time );
@@ -831,6 +876,18 @@ public:
       return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "eosio_global_state3", data, abi_serializer_max_time );
    }
 
+   fc::variant get_global_state4() {
+      vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, N(global4), N(global4) );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "eosio_global_state4", data, abi_serializer_max_time );
+   }
+
+   action_result setfeature( const name& feature, bool enabled = true ) {
+      return push_action( config::system_account_name, N(setfeature), mvo()
+                          ("feature", feature)
+                          ("enabled", enabled)
+      );
+   }
+
    fc::variant get_refund_request( name account ) {
       vector<char> data = get_row_by_account( config::system_account_name, account, N(refunds), account );
       return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "refund_request", data, abi_serializer_max_time );
@@ -1,8 +1,10 @@
 #include <boost/test/unit_test.hpp>
 #include <eosio/chain/contract_table_objects.hpp>
+#include <eosio/chain/generated_transaction_object.hpp>
 #include <eosio/chain/global_property_object.hpp>
 #include <eosio/chain/resource_limits.hpp>
 #include <eosio/chain/wast_to_wasm.hpp>
+#include <cmath>
 #include <cstdlib>
 #include <iostream>
 #include <sstream>
@@ -173,6 +175,116 @@ BOOST_FIXTURE_TEST_CASE( buysell, eosio_system_tester ) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( onboard_account, eosio_system_tester ) try {
+
+   transfer( "eosio", "alice1111111", core_sym::from_string("1000.0000"), "eosio" );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("must purchase a positive amount"),
+                        push_action( N(alice1111111), N(onboard), mvo()
+                                     ("payer", "alice1111111")
+                                     ("receiver", "bob111111111")
+                                     ("ram_bytes", 0)
+                                     ("stake_net_quantity", core_sym::from_string("10.0000"))
+                                     ("stake_cpu_quantity", core_sym::from_string("20.0000"))
+                                     ("transfer", false) ) );
+
+   // create the account and give it ram and bandwidth in one transaction
+   {
+      const account_name a = N(onboarded111);
+      signed_transaction trx;
+      set_transaction_headers(trx);
+      trx.actions.emplace_back( vector<permission_level>{{N(alice1111111), config::active_name}},
+                                newaccount{
+                                   .creator  = N(alice1111111),
+                                   .name     = a,
+                                   .owner    = authority( get_public_key( a, "owner" ) ),
+                                   .active   = authority( get_public_key( a, "active" ) )
+                                });
+      trx.actions.emplace_back( get_action( config::system_account_name, N(onboard), vector<permission_level>{{N(alice1111111), config::active_name}},
+                                            mvo()
+                                            ("payer", "alice1111111")
+                                            ("receiver", a)
+                                            ("ram_bytes", 8192)
+                                            ("stake_net_quantity", core_sym::from_string("10.0000"))
+                                            ("stake_cpu_quantity", core_sym::from_string("20.0000"))
+                                            ("transfer", false) ) );
+      set_transaction_headers(trx);
+      trx.sign( get_private_key( N(alice1111111), "active" ), control->get_chain_id() );
+      push_transaction( trx );
+   }
+
+   auto total = get_total_stake( "onboarded111" );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("10.0000"), total["net_weight"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("20.0000"), total["cpu_weight"].as<asset>() );
+   BOOST_REQUIRE( within_one( 8192, total["ram_bytes"].as_int64() ) );
+
+   auto dbw = get_dbw_obj( N(alice1111111), N(onboarded111) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("10.0000"), dbw["net_weight"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("20.0000"), dbw["cpu_weight"].as<asset>() );
+
+   int64_t ram_bytes = 0, net_weight = 0, cpu_weight = 0;
+   control->get_resource_limits_manager().get_account_limits( N(onboarded111), ram_bytes, net_weight, cpu_weight );
+   BOOST_REQUIRE_EQUAL( total["ram_bytes"].as_int64() + 1400, ram_bytes );
+   BOOST_REQUIRE_EQUAL( 10'0000, net_weight );
+   BOOST_REQUIRE_EQUAL( 20'0000, cpu_weight );
+
+   BOOST_REQUIRE_EQUAL( 30'0000, get_voter_info( "alice1111111" )["staked"].as<int64_t>() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( import_accounts, eosio_system_tester ) try {
+
+   const auto import_record = []( const account_name& a, int64_t ram_bytes, const char* net, const char* cpu ) {
+      return mvo()("account", a)("ram_bytes", ram_bytes)("net_weight", core_sym::from_string(net))("cpu_weight", core_sym::from_string(cpu));
+   };
+   const std::vector<fc::variant> records = { import_record( N(alice1111111), 10000, "10.0000", "20.0000" ),
+                                              import_record( N(bob111111111), 0, "5.0000", "0.0000" ) };
+
+   BOOST_REQUIRE_EQUAL( error("missing authority of eosio"),
+                        push_action( N(alice1111111), N(importaccts), mvo()("accounts", records) ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("account does not exist"),
+                        push_action( config::system_account_name, N(importaccts),
+                                     mvo()("accounts", std::vector<fc::variant>{ import_record( N(nonexistent1), 0, "1.0000", "1.0000" ) }) ) );
+
+   const uint64_t alice_ram     = get_total_stake( "alice1111111" )["ram_bytes"].as_uint64();
+   const asset    alice_net     = get_total_stake( "alice1111111" )["net_weight"].as<asset>();
+   const asset    bob_cpu       = get_total_stake( "bob111111111" )["cpu_weight"].as<asset>();
+   const uint64_t ram_reserved  = get_global_state()["total_ram_bytes_reserved"].as_uint64();
+   const asset    stake_balance = get_balance( N(eosio.stake) );
+   const int64_t  eosio_ram_usage = control->get_resource_limits_manager().get_account_ram_usage( config::system_account_name );
+
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, N(importaccts), mvo()("accounts", records) ) );
+   // the new rows are billed to the imported accounts
+   BOOST_REQUIRE_EQUAL( eosio_ram_usage, control->get_resource_limits_manager().get_account_ram_usage( config::system_account_name ) );
+
+   BOOST_REQUIRE_EQUAL( alice_ram + 10000, get_total_stake( "alice1111111" )["ram_bytes"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( alice_net + core_sym::from_string("10.0000"), get_total_stake( "alice1111111" )["net_weight"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( bob_cpu, get_total_stake( "bob111111111" )["cpu_weight"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( ram_reserved + 10000, get_global_state()["total_ram_bytes_reserved"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( stake_balance + core_sym::from_string("35.0000"), get_balance( N(eosio.stake) ) );
+
+   auto dbw = get_dbw_obj( N(alice1111111), N(alice1111111) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("10.0000"), dbw["net_weight"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("20.0000"), dbw["cpu_weight"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( 30'0000, get_voter_info( "alice1111111" )["staked"].as<int64_t>() );
+   BOOST_REQUIRE_EQUAL(  5'0000, get_voter_info( "bob111111111" )["staked"].as<int64_t>() );
+
+   // imported stake belongs to the account
+   BOOST_REQUIRE_EQUAL( success(), unstake( "alice1111111", "alice1111111", core_sym::from_string("10.0000"), core_sym::from_string("20.0000") ) );
+
+   // the imported ram must be available in the ram market
+   const int64_t max_ram_size = get_global_state()["max_ram_size"].as_int64();
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("cannot import more ram than max ram size"),
+                        push_action( config::system_account_name, N(importaccts),
+                                     mvo()("accounts", std::vector<fc::variant>{ import_record( N(alice1111111), max_ram_size + 1, "0.0000", "0.0000" ) }) ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("insufficient ram in market"),
+                        push_action( config::system_account_name, N(importaccts),
+                                     mvo()("accounts", std::vector<fc::variant>{ import_record( N(alice1111111), max_ram_size / 2 + 1, "0.0000", "0.0000" ),
+                                                                                 import_record( N(bob111111111), max_ram_size / 2 + 1, "0.0000", "0.0000" ) }) ) );
+   BOOST_REQUIRE_EQUAL( ram_reserved + 10000, get_global_state()["total_ram_bytes_reserved"].as_uint64() );
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE( stake_unstake, eosio_system_tester ) try {
    cross_15_percent_threshold();
 
@@ -238,6 +350,80 @@ BOOST_FIXTURE_TEST_CASE( stake_unstake, eosio_system_tester ) try {
    BOOST_REQUIRE_EQUAL( core_sym::from_string("1000.0000"), get_balance( "alice1111111" ) );
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( stake_unstake_lazy_refunds, eosio_system_tester ) try {
+   cross_15_percent_threshold();
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("refunds are settled by deferred transactions unless lazy refunds are enabled"),
+                        push_action( N(bob111111111), N(settlerefund), mvo()("user", "bob111111111")("max", 10) ) );
+   BOOST_REQUIRE_EQUAL( success(), setfeature( N(lazyrefunds) ) );
+
+   transfer( "eosio", "alice1111111", core_sym::from_string("1000.0000"), "eosio" );
+   const auto init_eosio_stake_balance = get_balance( N(eosio.stake) );
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", "alice1111111", core_sym::from_string("200.0000"), core_sym::from_string("100.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), unstake( "alice1111111", "alice1111111", core_sym::from_string("200.0000"), core_sym::from_string("100.0000") ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("700.0000"), get_balance( "alice1111111" ) );
+   BOOST_REQUIRE_EQUAL( false, get_refund_request( N(alice1111111) ).is_null() );
+
+   // no deferred refund, the matured refund is settled by the crank
+   produce_block( fc::hours(3*24) );
+   produce_blocks(1);
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("700.0000"), get_balance( "alice1111111" ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(bob111111111), N(settlerefund), mvo()("user", "bob111111111")("max", 10) ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("1000.0000"), get_balance( "alice1111111" ) );
+   BOOST_REQUIRE_EQUAL( init_eosio_stake_balance, get_balance( N(eosio.stake) ) );
+   BOOST_REQUIRE_EQUAL( true, get_refund_request( N(alice1111111) ).is_null() );
+
+   // a matured refund is settled by the owner's next change of stake
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", "alice1111111", core_sym::from_string("200.0000"), core_sym::from_string("100.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), unstake( "alice1111111", "alice1111111", core_sym::from_string("200.0000"), core_sym::from_string("100.0000") ) );
+   produce_block( fc::hours(3*24) );
+   produce_blocks(1);
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("700.0000"), get_balance( "alice1111111" ) );
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", "bob111111111", core_sym::from_string("10.0000"), core_sym::from_string("10.0000") ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("980.0000"), get_balance( "alice1111111" ) );
+   BOOST_REQUIRE_EQUAL( true, get_refund_request( N(alice1111111) ).is_null() );
+
+   // nothing left to settle
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(bob111111111), N(settlerefund), mvo()("user", "bob111111111")("max", 10) ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("980.0000"), get_balance( "alice1111111" ) );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( stake_unstake_lazy_refunds_upgrade, eosio_system_tester ) try {
+   cross_15_percent_threshold();
+
+   auto has_deferred_refund = [&]( const account_name& owner ) {
+      const auto& idx = control->db().get_index<generated_transaction_multi_index, by_trx_id>();
+      for ( const auto& gto : idx ) {
+         if ( gto.sender == config::system_account_name && gto.sender_id == uint128_t(owner.value) )
+            return true;
+      }
+      return false;
+   };
+
+   transfer( "eosio", "alice1111111", core_sym::from_string("1000.0000"), "eosio" );
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", "alice1111111", core_sym::from_string("200.0000"), core_sym::from_string("100.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), unstake( "alice1111111", "alice1111111", core_sym::from_string("100.0000"), core_sym::from_string("50.0000") ) );
+   BOOST_REQUIRE_EQUAL( true, has_deferred_refund( N(alice1111111) ) );
+
+   BOOST_REQUIRE_EQUAL( success(), setfeature( N(lazyrefunds) ) );
+
+   // the refund deferred before the upgrade is cancelled when the refund is next changed
+   BOOST_REQUIRE_EQUAL( success(), unstake( "alice1111111", "alice1111111", core_sym::from_string("100.0000"), core_sym::from_string("50.0000") ) );
+   BOOST_REQUIRE_EQUAL( false, has_deferred_refund( N(alice1111111) ) );
+   auto refund = get_refund_request( N(alice1111111) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("200.0000"), refund["net_amount"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("100.0000"), refund["cpu_amount"].as<asset>() );
+
+   produce_block( fc::hours(3*24) );
+   produce_blocks(1);
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("700.0000"), get_balance( "alice1111111" ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(bob111111111), N(settlerefund), mvo()("user", "bob111111111")("max", 10) ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("1000.0000"), get_balance( "alice1111111" ) );
+   BOOST_REQUIRE_EQUAL( true, get_refund_request( N(alice1111111) ).is_null() );
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE( stake_unstake_with_transfer, eosio_system_tester ) try {
    cross_15_percent_threshold();
 
@@ -803,6 +989,32 @@ BOOST_FIXTURE_TEST_CASE( producer_register_unregister, eosio_system_tester ) try
 } FC_LOG_AND_RETHROW()
 
 
+BOOST_FIXTURE_TEST_CASE( stake2vote_week_boundaries, eosio_system_tester ) try {
+
+   BOOST_REQUIRE_EQUAL( success(), regproducer( "alice1111111" ) );
+   transfer( "eosio", "bob111111111", core_sym::from_string("2000.0000"), "eosio" );
+   BOOST_REQUIRE_EQUAL( success(), stake( "bob111111111", core_sym::from_string("1111.1111"), core_sym::from_string("222.2222") ) );
+   const asset staked( get_voter_info( "bob111111111" )["staked"].as_int64(), symbol{CORE_SYM} );
+
+   const int64_t usecs_per_week = int64_t(7) * 24 * 3600 * 1000000;
+   const int64_t epoch          = int64_t(config::block_timestamp_epoch) * 1000;
+   const int64_t weeks          = ( control->head_block_time().time_since_epoch().count() - epoch ) / usecs_per_week;
+   const int64_t next_year      = weeks - weeks % 52 + 52;
+
+   // the weight of a vote cast in the middle of the week matches std::pow( 2, weeks / 52. ) to within 1 ulp
+   for ( int64_t week : { 0, 1, 30, 35, 48, 51, 52, 82, 87, 100 } ) {
+      const int64_t target = epoch + ( next_year + week ) * usecs_per_week + usecs_per_week / 2;
+      produce_block( fc::microseconds( target - control->head_block_time().time_since_epoch().count() ) );
+      BOOST_REQUIRE_EQUAL( success(), vote( N(bob111111111), { N(alice1111111) } ) );
+
+      const double weight   = get_voter_info( "bob111111111" )["last_vote_weight"].as_double();
+      const double expected = stake2votes( staked );
+      BOOST_REQUIRE_MESSAGE( weight == expected || std::nextafter( expected, weight ) == weight,
+                             "week " << week << ": " << weight << " != " << expected );
+   }
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE( vote_for_producer, eosio_system_tester, * boost::unit_test::tolerance(1e+5) ) try {
    cross_15_percent_threshold();
 
@@ -1272,10 +1484,10 @@ BOOST_FIXTURE_TEST_CASE(producer_pay, eosio_system_tester, * boost::unit_test::t
       const int64_t  initial_pervote_bucket    = initial_global_state["pervote_bucket"].as<int64_t>();
       const int64_t  initial_perblock_bucket   = initial_global_state["perblock_bucket"].as<int64_t>();
       const int64_t  initial_savings           = get_balance(N(eosio.saving)).get_amount();
-      const uint32_t initial_tot_unpaid_blocks = initial_global_state["total_unpaid_blocks"].as<uint32_t>();
+      const uint32_t initial_tot_unpaid_blocks = initial_global_state["total_unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks();
 
       prod = get_producer_info("defproducera");
-      const uint32_t unpaid_blocks = prod["unpaid_blocks"].as<uint32_t>();
+      const uint32_t unpaid_blocks = prod["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(N(defproducera));
       BOOST_REQUIRE(1 < unpaid_blocks);
 
       BOOST_REQUIRE_EQUAL(initial_tot_unpaid_blocks, unpaid_blocks);
@@ -1290,10 +1502,10 @@ BOOST_FIXTURE_TEST_CASE(producer_pay, eosio_system_tester, * boost::unit_test::t
       const int64_t  pervote_bucket    = global_state["pervote_bucket"].as<int64_t>();
       const int64_t  perblock_bucket   = global_state["perblock_bucket"].as<int64_t>();
       const int64_t  savings           = get_balance(N(eosio.saving)).get_amount();
-      const uint32_t tot_unpaid_blocks = global_state["total_unpaid_blocks"].as<uint32_t>();
+      const uint32_t tot_unpaid_blocks = global_state["total_unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks();
 
       prod = get_producer_info("defproducera");
-      BOOST_REQUIRE_EQUAL(1, prod["unpaid_blocks"].as<uint32_t>());
+      BOOST_REQUIRE_EQUAL(1, prod["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(N(defproducera)));
       BOOST_REQUIRE_EQUAL(1, tot_unpaid_blocks);
       const asset supply  = get_token_supply();
       const asset balance = get_balance(N(defproducera));
@@ -1348,11 +1560,11 @@ BOOST_FIXTURE_TEST_CASE(producer_pay, eosio_system_tester, * boost::unit_test::t
       const int64_t  initial_pervote_bucket    = initial_global_state["pervote_bucket"].as<int64_t>();
       const int64_t  initial_perblock_bucket   = initial_global_state["perblock_bucket"].as<int64_t>();
       const int64_t  initial_savings           = get_balance(N(eosio.saving)).get_amount();
-      const uint32_t initial_tot_unpaid_blocks = initial_global_state["total_unpaid_blocks"].as<uint32_t>();
+      const uint32_t initial_tot_unpaid_blocks = initial_global_state["total_unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks();
       const double   initial_tot_vote_weight   = initial_global_state["total_producer_vote_weight"].as<double>();
 
       prod = get_producer_info("defproducera");
-      const uint32_t unpaid_blocks = prod["unpaid_blocks"].as<uint32_t>();
+      const uint32_t unpaid_blocks = prod["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(N(defproducera));
       BOOST_REQUIRE(1 < unpaid_blocks);
       BOOST_REQUIRE_EQUAL(initial_tot_unpaid_blocks, unpaid_blocks);
       BOOST_REQUIRE(0 < prod["total_votes"].as<double>());
@@ -1371,10 +1583,10 @@ BOOST_FIXTURE_TEST_CASE(producer_pay, eosio_system_tester, * boost::unit_test::t
       const int64_t  pervote_bucket    = global_state["pervote_bucket"].as<int64_t>();
       const int64_t  perblock_bucket   = global_state["perblock_bucket"].as<int64_t>();
       const int64_t  savings           = get_balance(N(eosio.saving)).get_amount();
-      const uint32_t tot_unpaid_blocks = global_state["total_unpaid_blocks"].as<uint32_t>();
+      const uint32_t tot_unpaid_blocks = global_state["total_unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks();
 
       prod = get_producer_info("defproducera");
-      BOOST_REQUIRE_EQUAL(1, prod["unpaid_blocks"].as<uint32_t>());
+      BOOST_REQUIRE_EQUAL(1, prod["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(N(defproducera)));
       BOOST_REQUIRE_EQUAL(1, tot_unpaid_blocks);
       const asset supply  = get_token_supply();
       const asset balance = get_balance(N(defproducera));
@@ -1493,7 +1705,8 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
       auto prodv = get_producer_info( N(defproducerv) );
       auto prodz = get_producer_info( N(defproducerz) );
 
-      BOOST_REQUIRE (0 == proda["unpaid_blocks"].as<uint32_t>() && 0 == prodz["unpaid_blocks"].as<uint32_t>());
+      BOOST_REQUIRE (0 == proda["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(N(defproducera))
+                     && 0 == prodz["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(N(defproducerz)));
 
       // check vote ratios
       BOOST_REQUIRE ( 0 < proda["total_votes"].as<double>() && 0 < prodz["total_votes"].as<double>() );
@@ -1509,13 +1722,13 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
       produce_blocks(23 * 12 + 20);
       bool all_21_produced = true;
       for (uint32_t i = 0; i < 21; ++i) {
-         if (0 == get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+         if (0 == get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(producer_names[i])) {
             all_21_produced = false;
          }
       }
       bool rest_didnt_produce = true;
       for (uint32_t i = 21; i < producer_names.size(); ++i) {
-         if (0 < get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+         if (0 < get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(producer_names[i])) {
             rest_didnt_produce = false;
          }
       }
@@ -1546,12 +1759,12 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
       const int64_t  initial_pervote_bucket    = initial_global_state["pervote_bucket"].as<int64_t>();
       const int64_t  initial_perblock_bucket   = initial_global_state["perblock_bucket"].as<int64_t>();
       const int64_t  initial_savings           = get_balance(N(eosio.saving)).get_amount();
-      const uint32_t initial_tot_unpaid_blocks = initial_global_state["total_unpaid_blocks"].as<uint32_t>();
+      const uint32_t initial_tot_unpaid_blocks = initial_global_state["total_unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks();
       const asset    initial_supply            = get_token_supply();
       const asset    initial_bpay_balance      = get_balance(N(eosio.bpay));
       const asset    initial_vpay_balance      = get_balance(N(eosio.vpay));
       const asset    initial_balance           = get_balance(prod_name);
-      const uint32_t initial_unpaid_blocks     = get_producer_info(prod_name)["unpaid_blocks"].as<uint32_t>();
+      const uint32_t initial_unpaid_blocks     = get_producer_info(prod_name)["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(prod_name);
 
       BOOST_REQUIRE_EQUAL(success(), push_action(prod_name, N(claimrewards), mvo()("owner", prod_name)));
 
@@ -1560,12 +1773,12 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
       const int64_t  pervote_bucket    = global_state["pervote_bucket"].as<int64_t>();
       const int64_t  perblock_bucket   = global_state["perblock_bucket"].as<int64_t>();
       const int64_t  savings           = get_balance(N(eosio.saving)).get_amount();
-      const uint32_t tot_unpaid_blocks = global_state["total_unpaid_blocks"].as<uint32_t>();
+      const uint32_t tot_unpaid_blocks = global_state["total_unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks();
       const asset    supply            = get_token_supply();
       const asset    bpay_balance      = get_balance(N(eosio.bpay));
       const asset    vpay_balance      = get_balance(N(eosio.vpay));
       const asset    balance           = get_balance(prod_name);
-      const uint32_t unpaid_blocks     = get_producer_info(prod_name)["unpaid_blocks"].as<uint32_t>();
+      const uint32_t unpaid_blocks     = get_producer_info(prod_name)["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(prod_name);
 
       const uint64_t usecs_between_fills = claim_time - initial_claim_time;
       const int32_t secs_between_fills = static_cast<int32_t>(usecs_between_fills / 1000000);
@@ -1622,12 +1835,12 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
       const int64_t  initial_pervote_bucket    = initial_global_state["pervote_bucket"].as<int64_t>();
       const int64_t  initial_perblock_bucket   = initial_global_state["perblock_bucket"].as<int64_t>();
       const int64_t  initial_savings           = get_balance(N(eosio.saving)).get_amount();
-      const uint32_t initial_tot_unpaid_blocks = initial_global_state["total_unpaid_blocks"].as<uint32_t>();
+      const uint32_t initial_tot_unpaid_blocks = initial_global_state["total_unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks();
       const asset    initial_supply            = get_token_supply();
       const asset    initial_bpay_balance      = get_balance(N(eosio.bpay));
       const asset    initial_vpay_balance      = get_balance(N(eosio.vpay));
       const asset    initial_balance           = get_balance(prod_name);
-      const uint32_t initial_unpaid_blocks     = get_producer_info(prod_name)["unpaid_blocks"].as<uint32_t>();
+      const uint32_t initial_unpaid_blocks     = get_producer_info(prod_name)["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(prod_name);
 
       BOOST_REQUIRE_EQUAL(success(), push_action(prod_name, N(claimrewards), mvo()("owner", prod_name)));
 
@@ -1636,12 +1849,12 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
       const int64_t  pervote_bucket    = global_state["pervote_bucket"].as<int64_t>();
       const int64_t  perblock_bucket   = global_state["perblock_bucket"].as<int64_t>();
       const int64_t  savings           = get_balance(N(eosio.saving)).get_amount();
-      const uint32_t tot_unpaid_blocks = global_state["total_unpaid_blocks"].as<uint32_t>();
+      const uint32_t tot_unpaid_blocks = global_state["total_unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks();
       const asset    supply            = get_token_supply();
       const asset    bpay_balance      = get_balance(N(eosio.bpay));
       const asset    vpay_balance      = get_balance(N(eosio.vpay));
       const asset    balance           = get_balance(prod_name);
-      const uint32_t unpaid_blocks     = get_producer_info(prod_name)["unpaid_blocks"].as<uint32_t>();
+      const uint32_t unpaid_blocks     = get_producer_info(prod_name)["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(prod_name);
 
       const uint64_t usecs_between_fills = claim_time - initial_claim_time;
 
@@ -1701,7 +1914,7 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
       {
          bool rest_didnt_produce = true;
          for (uint32_t i = 21; i < producer_names.size(); ++i) {
-            if (0 < get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+            if (0 < get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(producer_names[i])) {
                rest_didnt_produce = false;
             }
          }
@@ -1710,17 +1923,17 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
 
       produce_blocks(3 * 21 * 12);
       info = get_producer_info(prod_name);
-      const uint32_t init_unpaid_blocks = info["unpaid_blocks"].as<uint32_t>();
+      const uint32_t init_unpaid_blocks = info["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(prod_name);
       BOOST_REQUIRE( !info["is_active"].as<bool>() );
       BOOST_REQUIRE( fc::crypto::public_key() == fc::crypto::public_key(info["producer_key"].as_string()) );
       BOOST_REQUIRE_EQUAL( wasm_assert_msg("producer does not have an active key"),
                            push_action(prod_name, N(claimrewards), mvo()("owner", prod_name) ) );
       produce_blocks(3 * 21 * 12);
-      BOOST_REQUIRE_EQUAL( init_unpaid_blocks, get_producer_info(prod_name)["unpaid_blocks"].as<uint32_t>() );
+      BOOST_REQUIRE_EQUAL( init_unpaid_blocks, get_producer_info(prod_name)["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(prod_name) );
       {
          bool prod_was_replaced = false;
          for (uint32_t i = 21; i < producer_names.size(); ++i) {
-            if (0 < get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+            if (0 < get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(producer_names[i])) {
                prod_was_replaced = true;
             }
          }
@@ -1756,10 +1969,10 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
       const uint64_t initial_bucket_fill_time  = microseconds_since_epoch_of_iso_string( initial_global_state["last_pervote_bucket_fill"] );
       const int64_t  initial_pervote_bucket    = initial_global_state["pervote_bucket"].as<int64_t>();
       const int64_t  initial_perblock_bucket   = initial_global_state["perblock_bucket"].as<int64_t>();
-      const uint32_t initial_tot_unpaid_blocks = initial_global_state["total_unpaid_blocks"].as<uint32_t>();
+      const uint32_t initial_tot_unpaid_blocks = initial_global_state["total_unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks();
       const asset    initial_supply            = get_token_supply();
       const asset    initial_balance           = get_balance(prod_name);
-      const uint32_t initial_unpaid_blocks     = initial_prod_info["unpaid_blocks"].as<uint32_t>();
+      const uint32_t initial_unpaid_blocks     = initial_prod_info["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(prod_name);
       const uint64_t initial_claim_time        = microseconds_since_epoch_of_iso_string( initial_prod_info["last_claim_time"] );
       const uint64_t initial_prod_update_time  = microseconds_since_epoch_of_iso_string( initial_prod_info2["last_votepay_share_update"] );
 
@@ -1773,10 +1986,10 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
       const uint64_t bucket_fill_time  = microseconds_since_epoch_of_iso_string( global_state["last_pervote_bucket_fill"] );
       const int64_t  pervote_bucket    = global_state["pervote_bucket"].as<int64_t>();
       const int64_t  perblock_bucket   = global_state["perblock_bucket"].as<int64_t>();
-      const uint32_t tot_unpaid_blocks = global_state["total_unpaid_blocks"].as<uint32_t>();
+      const uint32_t tot_unpaid_blocks = global_state["total_unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks();
       const asset    supply            = get_token_supply();
       const asset    balance           = get_balance(prod_name);
-      const uint32_t unpaid_blocks     = prod_info["unpaid_blocks"].as<uint32_t>();
+      const uint32_t unpaid_blocks     = prod_info["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(prod_name);
       const uint64_t claim_time        = microseconds_since_epoch_of_iso_string( prod_info["last_claim_time"] );
       const uint64_t prod_update_time  = microseconds_since_epoch_of_iso_string( prod_info2["last_votepay_share_update"] );
 
@@ -1807,6 +2020,43 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
                            push_action(prod_name, N(claimrewards), mvo()("owner", prod_name) ) );
    }
 
+   // switch to periodic inflation issuance
+   {
+      BOOST_REQUIRE_EQUAL( wasm_assert_msg("buckets are filled by claimrewards unless periodic inflation is enabled"),
+                           push_action(producer_names[1], N(fillbuckets), mvo()("user", producer_names[1]) ) );
+      BOOST_REQUIRE_EQUAL( error("missing authority of eosio"),
+                           push_action(producer_names[1], N(setfeature), mvo()("feature", "perinflation")("enabled", true) ) );
+      BOOST_REQUIRE_EQUAL( wasm_assert_msg("unknown feature"), setfeature( N(nofeature) ) );
+      BOOST_REQUIRE_EQUAL( success(), setfeature( N(perinflation) ) );
+      BOOST_REQUIRE_EQUAL( 1, get_global_state4()["features"].as<uint64_t>() );
+      BOOST_REQUIRE_EQUAL( 1, get_global_state2()["revision"].as<uint8_t>() );
+
+      const asset    initial_supply           = get_token_supply();
+      const uint64_t initial_bucket_fill_time = microseconds_since_epoch_of_iso_string( get_global_state()["last_pervote_bucket_fill"] );
+
+      // onblock issues the inflation accumulated over the last day at the next schedule update
+      produce_block(fc::hours(24));
+      produce_blocks(2);
+
+      const asset    supply           = get_token_supply();
+      const uint64_t bucket_fill_time = microseconds_since_epoch_of_iso_string( get_global_state()["last_pervote_bucket_fill"] );
+      BOOST_REQUIRE( initial_bucket_fill_time < bucket_fill_time );
+      BOOST_REQUIRE( initial_supply < supply );
+
+      // claimrewards only pays out of the buckets
+      const uint32_t prod_index      = 3;
+      const auto     prod_name       = producer_names[prod_index];
+      const asset    initial_balance = get_balance(prod_name);
+      BOOST_REQUIRE_EQUAL( success(), push_action(prod_name, N(claimrewards), mvo()("owner", prod_name) ) );
+      BOOST_REQUIRE_EQUAL( supply, get_token_supply() );
+      BOOST_REQUIRE( initial_balance < get_balance(prod_name) );
+      BOOST_REQUIRE_EQUAL( bucket_fill_time, microseconds_since_epoch_of_iso_string( get_global_state()["last_pervote_bucket_fill"] ) );
+
+      // buckets were filled within the past hour, the crank does nothing
+      BOOST_REQUIRE_EQUAL( success(), push_action(producer_names[1], N(fillbuckets), mvo()("user", producer_names[1]) ) );
+      BOOST_REQUIRE_EQUAL( supply, get_token_supply() );
+   }
+
 } FC_LOG_AND_RETHROW()
 
 
@@ -1887,7 +2137,8 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_votepay_share, eosio_system_tester, *
       auto prodv = get_producer_info( N(defproducerv) );
       auto prodz = get_producer_info( N(defproducerz) );
 
-      BOOST_REQUIRE (0 == proda["unpaid_blocks"].as<uint32_t>() && 0 == prodz["unpaid_blocks"].as<uint32_t>());
+      BOOST_REQUIRE (0 == proda["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(N(defproducera))
+                     && 0 == prodz["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(N(defproducerz)));
 
       // check vote ratios
       BOOST_REQUIRE ( 0 < proda["total_votes"].as_double() && 0 < prodz["total_votes"].as_double() );
@@ -2542,13 +2793,13 @@ BOOST_FIXTURE_TEST_CASE(producer_onblock_check, eosio_system_tester) try {
       produce_blocks(21 * 12);
       bool all_21_produced = true;
       for (uint32_t i = 0; i < 21; ++i) {
-         if (0 == get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+         if (0 == get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(producer_names[i])) {
             all_21_produced= false;
          }
       }
       bool rest_didnt_produce = true;
       for (uint32_t i = 21; i < producer_names.size(); ++i) {
-         if (0 < get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+         if (0 < get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(producer_names[i])) {
             rest_didnt_produce = false;
          }
       }
@@ -2558,7 +2809,7 @@ BOOST_FIXTURE_TEST_CASE(producer_onblock_check, eosio_system_tester) try {
 
    {
       const char* claimrewards_activation_error_message = "cannot claim rewards until the chain is activated (at least 15% of all tokens participate in voting)";
-      BOOST_CHECK_EQUAL(0, get_global_state()["total_unpaid_blocks"].as<uint32_t>());
+      BOOST_CHECK_EQUAL(0, get_global_state()["total_unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks());
       BOOST_REQUIRE_EQUAL(wasm_assert_msg( claimrewards_activation_error_message ),
                           push_action(producer_names.front(), N(claimrewards), mvo()("owner", producer_names.front())));
       BOOST_REQUIRE_EQUAL(0, get_balance(producer_names.front()).get_amount());
@@ -2581,13 +2832,13 @@ BOOST_FIXTURE_TEST_CASE(producer_onblock_check, eosio_system_tester) try {
       produce_blocks(21 * 12);
       bool all_21_produced = true;
       for (uint32_t i = 0; i < 21; ++i) {
-         if (0 == get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+         if (0 == get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(producer_names[i])) {
             all_21_produced= false;
          }
       }
       bool rest_didnt_produce = true;
       for (uint32_t i = 21; i < producer_names.size(); ++i) {
-         if (0 < get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+         if (0 < get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(producer_names[i])) {
             rest_didnt_produce = false;
          }
       }
@@ -2602,6 +2853,87 @@ BOOST_FIXTURE_TEST_CASE(producer_onblock_check, eosio_system_tester) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE(unpaid_blocks_flush, eosio_system_tester) try {
+
+   const asset large_asset = core_sym::from_string("80.0000");
+   create_account_with_resources( N(producvotera), config::system_account_name, core_sym::from_string("1.0000"), false, large_asset, large_asset );
+
+   // create accounts {defproducera, defproducerb, defproducerc} and register as producers
+   std::vector<account_name> producer_names;
+   const std::string root("defproducer");
+   for ( char c = 'a'; c <= 'c'; ++c ) {
+      producer_names.emplace_back(root + std::string(1, c));
+   }
+   setup_producer_accounts(producer_names);
+   for (auto a:producer_names)
+      regproducer(a);
+
+   transfer(config::system_account_name, "producvotera", core_sym::from_string("400000000.0000"), config::system_account_name);
+   BOOST_REQUIRE_EQUAL(success(), stake("producvotera", core_sym::from_string("100000000.0000"), core_sym::from_string("100000000.0000")));
+   BOOST_REQUIRE_EQUAL(success(), vote( N(producvotera), { producer_names.front() }));
+   produce_blocks(50);
+
+   // counts a block of `producer` through an onblock pushed in the pending block, without a schedule update
+   auto push_onblock = [&]( const account_name& producer ) {
+      block_header header;
+      header.timestamp = get_global_state()["last_producer_schedule_update"].as<block_timestamp_type>();
+      header.producer  = producer;
+      signed_transaction trx;
+      trx.actions.emplace_back( vector<permission_level>{{config::system_account_name, config::active_name}},
+                                config::system_account_name, N(onblock), fc::raw::pack(header) );
+      set_transaction_headers(trx);
+      trx.sign( get_private_key( config::system_account_name, "active" ), control->get_chain_id() );
+      push_transaction( trx );
+   };
+   auto unpaid_blocks = [&]( const account_name& producer ) {
+      return get_producer_info(producer)["unpaid_blocks"].as<uint32_t>();
+   };
+
+   // the pending blocks of all producers are added to the producers table and the global state by claimrewards
+   {
+      const account_name claimer = producer_names[0];
+      const account_name other   = producer_names[1];
+      push_onblock( other );
+      BOOST_REQUIRE_EQUAL( 1, get_pending_unpaid_blocks(other) );
+      BOOST_REQUIRE_EQUAL( 0, unpaid_blocks(other) );
+
+      base_tester::push_action( config::system_account_name, N(claimrewards), claimer, mvo()("owner", claimer) );
+      BOOST_REQUIRE_EQUAL( 0, get_pending_unpaid_blocks() );
+      BOOST_REQUIRE( get_row_by_account( config::system_account_name, config::system_account_name, N(unpaidblocks), other ).empty() );
+      BOOST_REQUIRE_EQUAL( 0, unpaid_blocks(claimer) );
+      BOOST_REQUIRE_EQUAL( 1, unpaid_blocks(other) );
+      BOOST_REQUIRE_EQUAL( 1, get_global_state()["total_unpaid_blocks"].as<uint32_t>() );
+   }
+
+   // the pending blocks are flushed by the onblock that updates the producer schedule
+   {
+      const account_name prod_name = producer_names[0];
+      produce_blocks(2 * 120);
+      uint32_t prev_pending = get_pending_unpaid_blocks(prod_name);
+      uint32_t prev_unpaid  = unpaid_blocks(prod_name);
+      uint32_t prev_total   = get_global_state()["total_unpaid_blocks"].as<uint32_t>();
+      bool flushed = false;
+      for (uint32_t i = 0; i < 2 * 120 && !flushed; ++i) {
+         const uint32_t prev_schedule_update = get_global_state()["last_producer_schedule_update"].as<block_timestamp_type>().slot;
+         produce_block();
+         const uint32_t pending = get_pending_unpaid_blocks(prod_name);
+         if ( prev_schedule_update != get_global_state()["last_producer_schedule_update"].as<block_timestamp_type>().slot ) {
+            flushed = true;
+            BOOST_REQUIRE_EQUAL( 0, pending );
+            BOOST_REQUIRE_EQUAL( prev_unpaid + prev_pending + 1, unpaid_blocks(prod_name) );
+            BOOST_REQUIRE_EQUAL( prev_total + prev_pending + 1, get_global_state()["total_unpaid_blocks"].as<uint32_t>() );
+         } else {
+            BOOST_REQUIRE_EQUAL( prev_pending + 1, pending );
+            BOOST_REQUIRE_EQUAL( prev_unpaid, unpaid_blocks(prod_name) );
+            BOOST_REQUIRE_EQUAL( prev_total, get_global_state()["total_unpaid_blocks"].as<uint32_t>() );
+         }
+         prev_pending = pending;
+      }
+      BOOST_REQUIRE( flushed );
+   }
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE( voters_actions_affect_proxy_and_producers, eosio_system_tester, * boost::unit_test::tolerance(1e+6) ) try {
    cross_15_percent_threshold();
 
@@ -2873,6 +3205,16 @@ BOOST_FIXTURE_TEST_CASE( elect_producers /*_and_parameters*/, eosio_system_teste
    //config = config_to_variant( control->get_global_properties().configuration );
    //REQUIRE_EQUAL_OBJECTS(prod2_config, config);
 
+   // voting again for the same producers does not change the elected set, the schedule is not proposed again
+   const auto fingerprint      = get_global_state4()["last_proposed_schedule_fingerprint"].as_uint64();
+   const auto schedule_version = control->head_block_state()->active_schedule.version;
+   BOOST_REQUIRE( 0 != fingerprint );
+   BOOST_REQUIRE_EQUAL( success(), vote( N(alice1111111), { N(defproducer1) } ) );
+   produce_blocks(250);
+   BOOST_REQUIRE_EQUAL( fingerprint, get_global_state4()["last_proposed_schedule_fingerprint"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( schedule_version, control->head_block_state()->active_schedule.version );
+   BOOST_REQUIRE_EQUAL( 3, control->head_block_state()->active_schedule.producers.size() );
+
    // try to go back to 2 producers and fail
    BOOST_REQUIRE_EQUAL( success(), vote( N(bob111111111), { N(defproducer3) } ) );
    produce_blocks(250);
@@ -3020,7 +3362,7 @@ BOOST_FIXTURE_TEST_CASE( multiple_namebids, eosio_system_tester ) try {
 
    // stake enough to go above the 15% threshold
    stake_with_transfer( config::system_account_name, "alice", core_sym::from_string( "10000000.0000" ), core_sym::from_string( "10000000.0000" ) );
-   BOOST_REQUIRE_EQUAL(0, get_producer_info("producer")["unpaid_blocks"].as<uint32_t>());
+   BOOST_REQUIRE_EQUAL(0, get_producer_info("producer")["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks("producer"));
    BOOST_REQUIRE_EQUAL( success(), vote( N(alice), { N(producer) } ) );
 
    // need to wait for 14 days after going live
@@ -3093,13 +3435,56 @@ BOOST_FIXTURE_TEST_CASE( namebid_pending_winner, eosio_system_tester ) try {
 
    BOOST_REQUIRE_EQUAL( success(), bidname( "alice1111111", "prefa", core_sym::from_string( "50.0000" ) ));
    BOOST_REQUIRE_EQUAL( success(), bidname( "bob111111111", "prefb", core_sym::from_string( "30.0000" ) ));
+   BOOST_REQUIRE_EQUAL( name("prefa"), get_top_name_bid()["newname"].as<name>() );
    produce_block( fc::hours(100) ); //should close "perfa"
+   BOOST_REQUIRE_EQUAL( name("prefb"), get_top_name_bid()["newname"].as<name>() );
+   BOOST_REQUIRE_EQUAL( 30'0000, get_top_name_bid()["high_bid"].as<int64_t>() );
    produce_block( fc::hours(100) ); //should close "perfb"
+   BOOST_REQUIRE_EQUAL( name(), get_top_name_bid()["newname"].as<name>() );
 
    //despite "perfa" account hasn't been created, we should be able to create "perfb" account
    create_account_with_resources( N(prefb), N(bob111111111) );
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( namebid_lazy_refunds, eosio_system_tester ) try {
+   cross_15_percent_threshold();
+   produce_block( fc::hours(14*24) );    //wait 14 day for name auction activation
+   transfer( config::system_account_name, N(alice1111111), core_sym::from_string("10000.0000") );
+   transfer( config::system_account_name, N(bob111111111), core_sym::from_string("10000.0000") );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("bid refunds are paid by deferred transactions unless lazy bid refunds are enabled"),
+                        push_action( N(carol1111111), N(settlebids), mvo()("user", "carol1111111")("max", 10) ) );
+   BOOST_REQUIRE_EQUAL( success(), setfeature( N(lazybidrefnd) ) );
+   const asset initial_names_balance = get_balance( N(eosio.names) );
+
+   // no deferred refund when alice is outbid
+   BOOST_REQUIRE_EQUAL( success(), bidname( "alice1111111", "prefa", core_sym::from_string( "10.0000" ) ));
+   BOOST_REQUIRE_EQUAL( success(), bidname( "bob111111111", "prefa", core_sym::from_string( "20.0000" ) ));
+   produce_blocks(2);
+   BOOST_REQUIRE_EQUAL( core_sym::from_string( "9990.0000" ), get_balance( "alice1111111" ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string( "9980.0000" ), get_balance( "bob111111111" ) );
+
+   // the refund exceeds alice's next bid, the difference is paid back
+   BOOST_REQUIRE_EQUAL( success(), bidname( "alice1111111", "prefb", core_sym::from_string( "5.0000" ) ));
+   BOOST_REQUIRE_EQUAL( core_sym::from_string( "9995.0000" ), get_balance( "alice1111111" ) );
+
+   // the refund on prefb is deducted from alice's next bid on prefa
+   BOOST_REQUIRE_EQUAL( success(), bidname( "bob111111111", "prefb", core_sym::from_string( "6.0000" ) ));
+   BOOST_REQUIRE_EQUAL( success(), bidname( "alice1111111", "prefa", core_sym::from_string( "30.0000" ) ));
+   BOOST_REQUIRE_EQUAL( core_sym::from_string( "9970.0000" ), get_balance( "alice1111111" ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string( "9974.0000" ), get_balance( "bob111111111" ) );
+
+   // bob's refund on prefa is paid by the crank
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(carol1111111), N(settlebids), mvo()("user", "carol1111111")("max", 10) ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string( "9994.0000" ), get_balance( "bob111111111" ) );
+   BOOST_REQUIRE_EQUAL( initial_names_balance + core_sym::from_string( "36.0000" ), get_balance( N(eosio.names) ) );
+
+   // nothing left to settle
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(carol1111111), N(settlebids), mvo()("user", "carol1111111")("max", 10) ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string( "9994.0000" ), get_balance( "bob111111111" ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string( "9970.0000" ), get_balance( "alice1111111" ) );
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE( vote_producers_in_and_out, eosio_system_tester ) try {
 
    const asset net = core_sym::from_string("80.0000");
@@ -3143,13 +3528,13 @@ BOOST_FIXTURE_TEST_CASE( vote_producers_in_and_out, eosio_system_tester ) try {
       produce_blocks(23 * 12 + 20);
       bool all_21_produced = true;
       for (uint32_t i = 0; i < 21; ++i) {
-         if (0 == get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+         if (0 == get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(producer_names[i])) {
             all_21_produced = false;
          }
       }
       bool rest_didnt_produce = true;
       for (uint32_t i = 21; i < producer_names.size(); ++i) {
-         if (0 < get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+         if (0 < get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(producer_names[i])) {
             rest_didnt_produce = false;
          }
       }
@@ -3162,12 +3547,12 @@ BOOST_FIXTURE_TEST_CASE( vote_producers_in_and_out, eosio_system_tester ) try {
       const uint32_t new_prod_index  = 23;
       BOOST_REQUIRE_EQUAL(success(), stake("producvoterd", core_sym::from_string("40000000.0000"), core_sym::from_string("40000000.0000")));
       BOOST_REQUIRE_EQUAL(success(), vote(N(producvoterd), { producer_names[new_prod_index] }));
-      BOOST_REQUIRE_EQUAL(0, get_producer_info(producer_names[new_prod_index])["unpaid_blocks"].as<uint32_t>());
+      BOOST_REQUIRE_EQUAL(0, get_producer_info(producer_names[new_prod_index])["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(producer_names[new_prod_index]));
       produce_blocks(4 * 12 * 21);
-      BOOST_REQUIRE(0 < get_producer_info(producer_names[new_prod_index])["unpaid_blocks"].as<uint32_t>());
-      const uint32_t initial_unpaid_blocks = get_producer_info(producer_names[voted_out_index])["unpaid_blocks"].as<uint32_t>();
+      BOOST_REQUIRE(0 < get_producer_info(producer_names[new_prod_index])["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(producer_names[new_prod_index]));
+      const uint32_t initial_unpaid_blocks = get_producer_info(producer_names[voted_out_index])["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(producer_names[voted_out_index]);
       produce_blocks(2 * 12 * 21);
-      BOOST_REQUIRE_EQUAL(initial_unpaid_blocks, get_producer_info(producer_names[voted_out_index])["unpaid_blocks"].as<uint32_t>());
+      BOOST_REQUIRE_EQUAL(initial_unpaid_blocks, get_producer_info(producer_names[voted_out_index])["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks(producer_names[voted_out_index]));
       produce_block(fc::hours(24));
       BOOST_REQUIRE_EQUAL(success(), vote(N(producvoterd), { producer_names[voted_out_index] }));
       produce_blocks(2 * 12 * 21);
@@ -3478,6 +3863,7 @@ BOOST_FIXTURE_TEST_CASE( rex_auth, eosio_system_tester ) try {
    BOOST_REQUIRE_EQUAL( error(error_msg), push_action( bob, N(closerex), mvo()("owner", alice) ) );
 
    BOOST_REQUIRE_EQUAL( error("missing authority of eosio"), push_action( alice, N(setrex), mvo()("balance", one_eos) ) );
+   BOOST_REQUIRE_EQUAL( error("missing authority of eosio"), push_action( alice, N(setrexmaint), mvo()("action_budget", 0) ) );
 
 } FC_LOG_AND_RETHROW()
 
@@ -3977,6 +4363,48 @@ BOOST_FIXTURE_TEST_CASE( buy_sell_claim_rex, eosio_system_tester ) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( rex_partial_fills, eosio_system_tester ) try {
+
+   const asset init_balance = core_sym::from_string("1000000.0000");
+   const std::vector<account_name> accounts = { N(aliceaccount), N(bobbyaccount), N(carolaccount) };
+   account_name alice = accounts[0], bob = accounts[1], carol = accounts[2];
+   setup_rex_accounts( accounts, init_balance );
+
+   BOOST_REQUIRE_EQUAL( success(), setfeature( N(partialfills) ) );
+
+   BOOST_REQUIRE_EQUAL( success(), buyrex( alice, core_sym::from_string("100000.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), buyrex( bob,   core_sym::from_string("20000.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), rentcpu( carol, carol, core_sym::from_string("10000.0000") ) );
+   produce_block( fc::days(5) );
+
+   // not enough unlent tokens to fill alice's order, it is queued
+   const asset init_alice_rex = get_rex_balance( alice );
+   BOOST_REQUIRE_EQUAL( success(), sellrex( alice, init_alice_rex ) );
+   BOOST_REQUIRE_EQUAL( true,           get_rex_order(alice)["is_open"].as<bool>() );
+   BOOST_REQUIRE_EQUAL( init_alice_rex, get_rex_order(alice)["rex_requested"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( 0,              get_rex_order(alice)["proceeds"].as<asset>().get_amount() );
+
+   // the queued order is filled as far as unlent tokens allow and stays open
+   BOOST_REQUIRE_EQUAL( success(), rexexec( bob, 1 ) );
+   const asset remaining_rex = get_rex_order(alice)["rex_requested"].as<asset>();
+   const asset proceeds      = get_rex_order(alice)["proceeds"].as<asset>();
+   BOOST_REQUIRE_EQUAL( true,           get_rex_order(alice)["is_open"].as<bool>() );
+   BOOST_REQUIRE      ( 0 < remaining_rex.get_amount() && remaining_rex < init_alice_rex );
+   BOOST_REQUIRE      ( 0 < proceeds.get_amount() );
+   BOOST_REQUIRE_EQUAL( remaining_rex,  get_rex_balance( alice ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("rex loans are currently not available"),
+                        rentcpu( carol, carol, core_sym::from_string("1.0000") ) );
+
+   // canceling the order keeps the proceeds of the partial fill
+   const asset init_alice_fund = get_rex_fund( alice );
+   BOOST_REQUIRE_EQUAL( success(), push_action( alice, N(cnclrexorder), mvo()("owner", alice) ) );
+   BOOST_REQUIRE_EQUAL( true,                       get_rex_order_obj(alice).is_null() );
+   BOOST_REQUIRE_EQUAL( init_alice_fund + proceeds, get_rex_fund( alice ) );
+   BOOST_REQUIRE_EQUAL( remaining_rex,              get_rex_balance( alice ) );
+
+} FC_LOG_AND_RETHROW()
+
+
 
 BOOST_FIXTURE_TEST_CASE( rex_loans, eosio_system_tester ) try {
 
@@ -4115,6 +4543,51 @@ BOOST_FIXTURE_TEST_CASE( rex_loans, eosio_system_tester ) try {
 } FC_LOG_AND_RETHROW()
 
 
+BOOST_FIXTURE_TEST_CASE( rex_expired_loans_same_receiver, eosio_system_tester ) try {
+
+   const asset   init_balance = core_sym::from_string("40000.0000");
+   const std::vector<account_name> accounts = { N(aliceaccount), N(bobbyaccount), N(carolaccount) };
+   account_name alice = accounts[0], bob = accounts[1], carol = accounts[2];
+   setup_rex_accounts( accounts, init_balance );
+
+   BOOST_REQUIRE_EQUAL( success(), buyrex( alice, core_sym::from_string("25000.0000") ) );
+
+   const int64_t init_cpu        = get_cpu_limit( carol );
+   const int64_t init_net        = get_net_limit( carol );
+   const asset   init_cpu_weight = get_total_stake( carol )["cpu_weight"].as<asset>();
+   const asset   init_net_weight = get_total_stake( carol )["net_weight"].as<asset>();
+
+   // bob rents cpu and net for carol twice each
+   const asset payment = core_sym::from_string("30.0000");
+   BOOST_REQUIRE_EQUAL( success(), rentcpu( bob, carol, payment ) );
+   BOOST_REQUIRE_EQUAL( success(), rentcpu( bob, carol, payment ) );
+   BOOST_REQUIRE_EQUAL( success(), rentnet( bob, carol, payment ) );
+   BOOST_REQUIRE_EQUAL( success(), rentnet( bob, carol, payment ) );
+
+   const int64_t rented_cpu = get_cpu_loan(1)["total_staked"].as<asset>().get_amount()
+                              + get_cpu_loan(2)["total_staked"].as<asset>().get_amount();
+   const int64_t rented_net = get_net_loan(3)["total_staked"].as<asset>().get_amount()
+                              + get_net_loan(4)["total_staked"].as<asset>().get_amount();
+   BOOST_REQUIRE_EQUAL( init_cpu + rented_cpu, get_cpu_limit( carol ) );
+   BOOST_REQUIRE_EQUAL( init_net + rented_net, get_net_limit( carol ) );
+   BOOST_REQUIRE_EQUAL( init_cpu_weight.get_amount() + rented_cpu, get_total_stake( carol )["cpu_weight"].as<asset>().get_amount() );
+   BOOST_REQUIRE_EQUAL( init_net_weight.get_amount() + rented_net, get_total_stake( carol )["net_weight"].as<asset>().get_amount() );
+
+   // all four loans expire and are closed in the same runrex, carol's net and cpu drop by the combined loans
+   produce_block( fc::days(30) + fc::hours(1) );
+   BOOST_REQUIRE_EQUAL( success(), rexexec( alice, 4 ) );
+   BOOST_REQUIRE_EQUAL( true,            get_cpu_loan(1).is_null() );
+   BOOST_REQUIRE_EQUAL( true,            get_cpu_loan(2).is_null() );
+   BOOST_REQUIRE_EQUAL( true,            get_net_loan(3).is_null() );
+   BOOST_REQUIRE_EQUAL( true,            get_net_loan(4).is_null() );
+   BOOST_REQUIRE_EQUAL( init_cpu,        get_cpu_limit( carol ) );
+   BOOST_REQUIRE_EQUAL( init_net,        get_net_limit( carol ) );
+   BOOST_REQUIRE_EQUAL( init_cpu_weight, get_total_stake( carol )["cpu_weight"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( init_net_weight, get_total_stake( carol )["net_weight"].as<asset>() );
+
+} FC_LOG_AND_RETHROW()
+
+
 BOOST_FIXTURE_TEST_CASE( rex_loan_checks, eosio_system_tester ) try {
 
    const int64_t ratio        = 10000;
@@ -4146,6 +4619,82 @@ BOOST_FIXTURE_TEST_CASE( rex_loan_checks, eosio_system_tester ) try {
 } FC_LOG_AND_RETHROW()
 
 
+BOOST_FIXTURE_TEST_CASE( rex_maintenance_budget, eosio_system_tester ) try {
+
+   const asset   init_balance = core_sym::from_string("40000.0000");
+   const std::vector<account_name> accounts = { N(aliceaccount), N(bobbyaccount) };
+   account_name alice = accounts[0], bob = accounts[1];
+   setup_rex_accounts( accounts, init_balance );
+
+   const asset fee = core_sym::from_string("1.0000");
+   BOOST_REQUIRE_EQUAL( success(),            buyrex( alice, core_sym::from_string("20004.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(),            rentcpu( bob, bob, fee, fee + fee + fee ) );
+   BOOST_REQUIRE_EQUAL( 3 * fee.get_amount(), get_last_cpu_loan()["balance"].as<asset>().get_amount() );
+
+   // user actions no longer process expired loans, only rexexec does
+   BOOST_REQUIRE_EQUAL( success(),            push_action( config::system_account_name, N(setrexmaint), mvo()("action_budget", 0) ) );
+   produce_block( fc::days(31) );
+   BOOST_REQUIRE_EQUAL( success(),            buyrex( alice, fee ) );
+   BOOST_REQUIRE_EQUAL( 3 * fee.get_amount(), get_last_cpu_loan()["balance"].as<asset>().get_amount() );
+   BOOST_REQUIRE_EQUAL( success(),            rexexec( alice, 1 ) );
+   BOOST_REQUIRE_EQUAL( 2 * fee.get_amount(), get_last_cpu_loan()["balance"].as<asset>().get_amount() );
+
+   // restoring the budget lets user actions process expired loans again
+   BOOST_REQUIRE_EQUAL( success(),            push_action( config::system_account_name, N(setrexmaint), mvo()("action_budget", 2) ) );
+   produce_block( fc::days(31) );
+   BOOST_REQUIRE_EQUAL( success(),            buyrex( alice, fee ) );
+   BOOST_REQUIRE_EQUAL( fee.get_amount(),     get_last_cpu_loan()["balance"].as<asset>().get_amount() );
+
+} FC_LOG_AND_RETHROW()
+
+
+BOOST_FIXTURE_TEST_CASE( ram_and_rex_quotes, eosio_system_tester ) try {
+
+   const asset   init_balance = core_sym::from_string("40000.0000");
+   const std::vector<account_name> accounts = { N(aliceaccount), N(bobbyaccount) };
+   account_name alice = accounts[0], bob = accounts[1];
+   setup_rex_accounts( accounts, init_balance, core_sym::from_string("80.0000"), core_sym::from_string("80.0000"), false );
+
+   const asset ram_payment = core_sym::from_string("100.0000");
+   {
+      const asset   quote     = get_quote( alice, N(quotebuyram), mvo()("quant", ram_payment) );
+      const int64_t ram_bytes = get_total_stake( alice )["ram_bytes"].as_int64();
+      BOOST_REQUIRE( 0 < quote.get_amount() );
+      BOOST_REQUIRE_EQUAL( success(), buyram( alice, alice, ram_payment ) );
+      BOOST_REQUIRE_EQUAL( ram_bytes + quote.get_amount(), get_total_stake( alice )["ram_bytes"].as_int64() );
+   }
+   {
+      const asset quote   = get_quote( alice, N(quotesellram), mvo()("bytes", 1000) );
+      const asset balance = get_balance( alice );
+      BOOST_REQUIRE( 0 < quote.get_amount() );
+      BOOST_REQUIRE_EQUAL( success(), sellram( alice, 1000 ) );
+      BOOST_REQUIRE_EQUAL( balance + quote, get_balance( alice ) );
+   }
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("rex loans are currently not available"),
+                        push_action( bob, N(quoterent), mvo()("loan_payment", core_sym::from_string("1.0000")) ) );
+
+   BOOST_REQUIRE_EQUAL( success(), deposit( alice, core_sym::from_string("20000.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), deposit( bob, core_sym::from_string("100.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), buyrex( alice, core_sym::from_string("20000.0000") ) );
+   {
+      const asset payment = core_sym::from_string("10.0000");
+      const asset quote   = get_quote( bob, N(quoterent), mvo()("loan_payment", payment) );
+      BOOST_REQUIRE( 0 < quote.get_amount() );
+      BOOST_REQUIRE_EQUAL( quote, get_rentcpu_result( bob, bob, payment ) );
+   }
+
+   produce_block( fc::days(5) );
+   {
+      const asset rex   = asset::from_string("100.0000 REX");
+      const asset quote = get_quote( alice, N(quotesellrex), mvo()("rex", rex) );
+      BOOST_REQUIRE( 0 < quote.get_amount() );
+      BOOST_REQUIRE_EQUAL( quote, get_sellrex_result( alice, rex ) );
+   }
+
+} FC_LOG_AND_RETHROW()
+
+
 BOOST_FIXTURE_TEST_CASE( ramfee_namebid_to_rex, eosio_system_tester ) try {
 
    const int64_t ratio        = 10000;
@@ -100,6 +100,13 @@ public:
       );
    }
 
+   action_result transfers( account_name from, const vector<fc::variant>& transfers ) {
+      return push_action( from, N(transfers), mvo()
+           ( "from", from)
+           ( "transfers", transfers)
+      );
+   }
+
    action_result open( account_name owner,
                        const string& symbolname,
                        account_name ram_payer    ) {
@@ -343,6 +350,87 @@ BOOST_FIXTURE_TEST_CASE( transfer_tests, eosio_token_tester ) try {
       transfer( N(alice), N(bob), asset::from_string("-1000 CERO"), "hola" )
    );
 
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "symbol precision mismatch" ),
+      transfer( N(alice), N(bob), asset::from_string("1.0 CERO"), "hola" )
+   );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "symbol precision mismatch" ),
+      transfer( N(carol), N(bob), asset::from_string("1.0 CERO"), "hola" )
+   );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( transfers_tests, eosio_token_tester ) try {
+
+   create( N(alice), asset::from_string("1000 CERO") );
+   issue( N(alice), asset::from_string("1000 CERO"), "hola" );
+   create( N(alice), asset::from_string("1000.00 TWO") );
+   issue( N(alice), asset::from_string("1000.00 TWO"), "hola" );
+   produce_blocks(1);
+
+   BOOST_REQUIRE_EQUAL( success(), transfers( N(alice), {
+      mvo()("to", "bob")("quantity", "300 CERO")("memo", "hola"),
+      mvo()("to", "carol")("quantity", "200 CERO")("memo", ""),
+      mvo()("to", "bob")("quantity", "10.50 TWO")("memo", "hola"),
+      mvo()("to", "bob")("quantity", "100 CERO")("memo", "hola")
+   } ) );
+
+   REQUIRE_MATCHING_OBJECT( get_account(N(alice), "0,CERO"), mvo()("balance", "400 CERO") );
+   REQUIRE_MATCHING_OBJECT( get_account(N(bob), "0,CERO"), mvo()("balance", "400 CERO") );
+   REQUIRE_MATCHING_OBJECT( get_account(N(carol), "0,CERO"), mvo()("balance", "200 CERO") );
+   REQUIRE_MATCHING_OBJECT( get_account(N(alice), "2,TWO"), mvo()("balance", "989.50 TWO") );
+   REQUIRE_MATCHING_OBJECT( get_account(N(bob), "2,TWO"), mvo()("balance", "10.50 TWO") );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "no transfers" ),
+      transfers( N(alice), {} )
+   );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "overdrawn balance" ),
+      transfers( N(alice), {
+         mvo()("to", "bob")("quantity", "300 CERO")("memo", ""),
+         mvo()("to", "carol")("quantity", "101 CERO")("memo", "")
+      } )
+   );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "symbol precision mismatch" ),
+      transfers( N(alice), {
+         mvo()("to", "bob")("quantity", "1 CERO")("memo", ""),
+         mvo()("to", "carol")("quantity", "1.0 CERO")("memo", "")
+      } )
+   );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "cannot transfer to self" ),
+      transfers( N(alice), {
+         mvo()("to", "alice")("quantity", "1 CERO")("memo", "")
+      } )
+   );
+
+   REQUIRE_MATCHING_OBJECT( get_account(N(alice), "0,CERO"), mvo()("balance", "400 CERO") );
+
+   // each recipient is notified of the transfers action, there is no separate transfer action
+   auto trace = base_tester::push_action( N(eosio.token), N(transfers), N(alice), mvo()
+      ( "from", "alice" )
+      ( "transfers", vector<fc::variant>{
+         mvo()("to", "bob")("quantity", "5 CERO")("memo", "one"),
+         mvo()("to", "carol")("quantity", "7 CERO")("memo", "two")
+      } )
+   );
+   std::map<account_name, std::vector<action_name>> notifications;
+   for( const auto& at : trace->action_traces ) {
+      notifications[at.receiver].push_back( at.act.name );
+   }
+   BOOST_REQUIRE_EQUAL( 1, notifications[N(eosio.token)].size() );
+   BOOST_REQUIRE_EQUAL( N(transfers), notifications[N(eosio.token)][0] );
+   BOOST_REQUIRE_EQUAL( 1, notifications[N(alice)].size() );
+   BOOST_REQUIRE_EQUAL( N(transfers), notifications[N(alice)][0] );
+   BOOST_REQUIRE_EQUAL( 1, notifications[N(bob)].size() );
+   BOOST_REQUIRE_EQUAL( N(transfers), notifications[N(bob)][0] );
+   BOOST_REQUIRE_EQUAL( 1, notifications[N(carol)].size() );
+   BOOST_REQUIRE_EQUAL( N(transfers), notifications[N(carol)][0] );
+
+   REQUIRE_MATCHING_OBJECT( get_account(N(alice), "0,CERO"), mvo()("balance", "388 CERO") );
+   REQUIRE_MATCHING_OBJECT( get_account(N(bob), "0,CERO"), mvo()("balance", "405 CERO") );
+   REQUIRE_MATCHING_OBJECT( get_account(N(carol), "0,CERO"), mvo()("balance", "207 CERO") );
 
 } FC_LOG_AND_RETHROW()
 